@@ -0,0 +1,362 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+// Measures parser phases separately on a profile and its binaries:
+//   load        - MappingTable::load, reads binaries and registers function records
+//   decode      - regions of all functions, done lazily by the first profile in the parser
+//   readProfile - ProfileCounters::read
+//   mapping     - ProfileCoverage::load, the port of CoverageMapping::load
+//   processFile - ProfileCoverage::getSegmentsForFile for every covered file
+//   coverage    - CodeCoverage::coverage, the whole parsing with the result conversion
+//   merge/N     - CodeCoverage::merge of the result copies on the pool of N threads, from 1 to the number of cores
+// With --indexed the previous parser path is measured on the same profile for comparison:
+//   indexedRead - profile conversion with InstrProfWriter and IndexedInstrProfReader creation
+//   indexedMap  - CoverageMapping::load with the binary readers and the indexed profile
+//   indexedFile - CoverageMapping::getCoverageForFile for every covered file
+// Every phase reports min and median time, throughput and peak RSS of the process after the phase.
+// Compiled with the sources of one plugin, BENCHMARK_LLVM_NAMESPACE is llvm17 or llvm19.
+
+#include "CodeCoverage.hpp"
+#include "MappingTable.hpp"
+#include "ProfileCounters.hpp"
+#include "ProfileCoverage.hpp"
+
+// Computed include, LLVM headers have the version prefix
+#include BENCHMARK_INSTRPROF_WRITER_HEADER
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+using namespace BENCHMARK_LLVM_NAMESPACE;
+using namespace llvm;
+
+static ExitOnError ExitOnErr("coverage-parser-benchmark: ");
+
+namespace {
+
+struct Options {
+    unsigned Iterations = 5;
+    unsigned MergedResults = 16;
+    bool CSV = false;
+    bool Indexed = false;
+    StringRef Profile;
+    std::vector<StringRef> Binaries;
+};
+
+/// Timings of one phase. Items are counted by the phase body, so throughput is in the phase units
+struct Phase {
+    std::string Name;
+    const char *Unit;
+    std::vector<double> Seconds;
+    uint64_t Items = 0;
+    uint64_t PeakRSS = 0;
+};
+
+uint64_t peakRSS() {
+    struct rusage Usage;
+    getrusage(RUSAGE_SELF, &Usage);
+#ifdef __APPLE__
+    return uint64_t(Usage.ru_maxrss);
+#else
+    return uint64_t(Usage.ru_maxrss) * 1024;
+#endif
+}
+
+uint64_t fileSize(StringRef Path) {
+    struct stat Status;
+    if (stat(Path.str().c_str(), &Status) != 0) {
+        ExitOnErr(createStringError(std::error_code(errno, std::generic_category()), "Can't read %s", Path.data()));
+    }
+    return uint64_t(Status.st_size);
+}
+
+/// Runs Setup outside of the timer and Body inside of it. Body returns processed items
+template <typename SetupFn, typename BodyFn>
+Phase measure(std::string Name, const char *Unit, unsigned Iterations, SetupFn Setup, BodyFn Body) {
+    Phase Result{std::move(Name), Unit};
+    for (unsigned Iteration = 0; Iteration < Iterations; Iteration++) {
+        Setup();
+        auto Start = std::chrono::steady_clock::now();
+        Result.Items = Body();
+        auto End = std::chrono::steady_clock::now();
+        Result.Seconds.push_back(std::chrono::duration<double>(End - Start).count());
+    }
+    Result.PeakRSS = peakRSS();
+    return Result;
+}
+
+void print(const std::vector<Phase> &Phases, bool CSV) {
+    if (CSV) {
+        printf("phase,min_ms,median_ms,items,unit,items_per_second,peak_rss_mb\n");
+    } else {
+        printf("%-12s %10s %10s %12s %20s %12s\n", "phase", "min ms", "median ms", "items", "throughput", "peak RSS MB");
+    }
+    for (auto Phase : Phases) {
+        std::sort(Phase.Seconds.begin(), Phase.Seconds.end());
+        double Min = Phase.Seconds.front();
+        double Median = Phase.Seconds[Phase.Seconds.size() / 2];
+        double Throughput = Median > 0 ? double(Phase.Items) / Median : 0;
+        double RSS = double(Phase.PeakRSS) / (1024 * 1024);
+        if (CSV) {
+            printf("%s,%.3f,%.3f,%llu,%s,%.0f,%.1f\n", Phase.Name.c_str(), Min * 1000, Median * 1000,
+                   (unsigned long long)Phase.Items, Phase.Unit, Throughput, RSS);
+        } else {
+            std::string Rate = std::to_string(uint64_t(Throughput)) + " " + Phase.Unit + "/s";
+            printf("%-12s %10.3f %10.3f %12llu %20s %12.1f\n", Phase.Name.c_str(), Min * 1000, Median * 1000,
+                   (unsigned long long)Phase.Items, Rate.c_str(), RSS);
+        }
+    }
+}
+
+bool parse(int argc, const char **argv, Options &Result) {
+    for (int Index = 1; Index < argc; Index++) {
+        StringRef Arg(argv[Index]);
+        if (Arg == "-n" && Index + 1 < argc) {
+            if (StringRef(argv[++Index]).getAsInteger(10, Result.Iterations) || Result.Iterations == 0) {
+                return false;
+            }
+        } else if (Arg == "-m" && Index + 1 < argc) {
+            if (StringRef(argv[++Index]).getAsInteger(10, Result.MergedResults) || Result.MergedResults == 0) {
+                return false;
+            }
+        } else if (Arg == "--csv") {
+            Result.CSV = true;
+        } else if (Arg == "--indexed") {
+            Result.Indexed = true;
+        } else if (Arg.front() == '-') {
+            return false;
+        } else if (Result.Profile.empty()) {
+            Result.Profile = Arg;
+        } else {
+            Result.Binaries.push_back(Arg);
+        }
+    }
+    return !Result.Profile.empty() && !Result.Binaries.empty();
+}
+
+// Profile conversion of the previous parser revision.
+// Method based on `llvm-profdata merge` source code from LLVM tools.
+Expected<std::unique_ptr<IndexedInstrProfReader>> readIndexedProfile(StringRef ProfrawPath) {
+    auto BufferOrErr = errorOrToExpected(MemoryBuffer::getFile(ProfrawPath, /*IsText=*/false,
+                                                               /*RequiresNullTerminator=*/false));
+    if (Error E = BufferOrErr.takeError()) {
+        return std::move(E);
+    }
+    auto ReaderOrErr = InstrProfReader::create(std::move(BufferOrErr.get()));
+    if (Error E = ReaderOrErr.takeError()) {
+        return std::move(E);
+    }
+    auto Reader = std::move(ReaderOrErr.get());
+
+    InstrProfWriter Writer(/*sparse*/ true);
+    if (Error E = Writer.mergeProfileKind(Reader->getProfileKind())) {
+        return std::move(E);
+    }
+    std::optional<Error> WriteError;
+    for (auto &I : *Reader) {
+        Writer.addRecord(std::move(I), [&](Error E) {
+            WriteError = std::move(E);
+        });
+        if (WriteError.has_value()) {
+            return std::move(*WriteError);
+        }
+    }
+    if (Reader->hasTemporalProfile()) {
+        auto &Traces = Reader->getTemporalProfTraces();
+        if (!Traces.empty()) {
+            Writer.addTemporalProfileTraces(Traces, Reader->getTemporalProfTraceStreamSize());
+        }
+    }
+    if (Reader->hasError()) {
+        if (Error E = Reader->getError()) {
+            return std::move(E);
+        }
+    }
+    std::vector<object::BuildID> BinaryIds;
+    if (Error E = Reader->readBinaryIds(BinaryIds)) {
+        return std::move(E);
+    }
+    Writer.addBinaryIds(BinaryIds);
+
+    return IndexedInstrProfReader::create(Writer.writeBuffer());
+}
+
+/// Binary readers for CoverageMapping::load. Readers are consumed by the load, so they are created for every run
+struct BinaryReaders {
+    std::vector<std::unique_ptr<MemoryBuffer>> Buffers;
+    SmallVector<std::unique_ptr<MemoryBuffer>, 4> ObjectBuffers;
+    std::vector<std::unique_ptr<coverage::CoverageMappingReader>> Readers;
+
+    static BinaryReaders open(ArrayRef<StringRef> Binaries) {
+        BinaryReaders Result;
+        for (StringRef Binary : Binaries) {
+            auto Buffer = ExitOnErr(errorOrToExpected(MemoryBuffer::getFile(Binary, /*IsText=*/false,
+                                                                            /*RequiresNullTerminator=*/false)));
+            auto Readers = ExitOnErr(coverage::BinaryCoverageReader::create(Buffer->getMemBufferRef(), StringRef(),
+                                                                            Result.ObjectBuffers));
+            for (auto &Reader : Readers) {
+                Result.Readers.push_back(std::move(Reader));
+            }
+            Result.Buffers.push_back(std::move(Buffer));
+        }
+        return Result;
+    }
+};
+
+}
+
+int main(int argc, const char **argv) {
+    Options Opts;
+    if (!parse(argc, argv, Opts)) {
+        fprintf(stderr, "usage: %s [-n iterations] [-m merged results] [--csv] [--indexed] <profile> <binary>...\n", argv[0]);
+        return 2;
+    }
+
+    uint64_t BinariesSize = 0;
+    for (StringRef Binary : Opts.Binaries) {
+        BinariesSize += fileSize(Binary);
+    }
+    std::vector<Phase> Phases;
+    std::optional<MappingTable> Mappings;
+    auto loadMappings = [&] {
+        Mappings.reset();
+        Mappings.emplace(ExitOnErr(MappingTable::load(Opts.Binaries)));
+    };
+    auto allFunctions = [&] {
+        std::vector<uint32_t> Functions(Mappings->functions().size());
+        for (uint32_t Index = 0; Index < Functions.size(); Index++) {
+            Functions[Index] = Index;
+        }
+        return Functions;
+    };
+    auto countRegions = [&](ArrayRef<uint32_t> Functions) {
+        uint64_t Count = 0;
+        for (uint32_t Index : Functions) {
+            Count += Mappings->regions(Mappings->functions()[Index]).size();
+        }
+        return Count;
+    };
+
+    Phases.push_back(measure("load", "bytes", Opts.Iterations, [&] { Mappings.reset(); }, [&] {
+        loadMappings();
+        return BinariesSize;
+    }));
+
+    // Decode results are kept by the table, so every iteration needs a new one
+    std::vector<uint32_t> Functions;
+    Phases.push_back(measure("decode", "regions", Opts.Iterations, [&] {
+        loadMappings();
+        Functions = allFunctions();
+    }, [&] {
+        ExitOnErr(Mappings->decode(Functions));
+        return countRegions(Functions);
+    }));
+
+    uint64_t ProfileSize = fileSize(Opts.Profile);
+    std::optional<ProfileCounters> Profile;
+    Phases.push_back(measure("readProfile", "bytes", Opts.Iterations, [&] { Profile.reset(); }, [&] {
+        Profile.emplace(ExitOnErr(ProfileCounters::read(Opts.Profile)));
+        return ProfileSize;
+    }));
+
+    uint64_t ExecutedRegions = countRegions(ExitOnErr(ProfileCoverage::executedFunctions(*Mappings, *Profile)));
+    std::optional<ProfileCoverage> Coverage;
+    Phases.push_back(measure("mapping", "regions", Opts.Iterations, [&] { Coverage.reset(); }, [&] {
+        Coverage.emplace(ExitOnErr(ProfileCoverage::load(*Mappings, *Profile)));
+        return ExecutedRegions;
+    }));
+
+    Phases.push_back(measure("processFile", "segments", Opts.Iterations, [&] {
+        Coverage.reset();
+        Coverage.emplace(ExitOnErr(ProfileCoverage::load(*Mappings, *Profile)));
+    }, [&] {
+        uint64_t Segments = 0;
+        for (size_t Position = 0; Position < Coverage->files().size(); Position++) {
+            Segments += Coverage->getSegmentsForFile(Position).size();
+        }
+        return Segments;
+    }));
+    Coverage.reset();
+    Mappings.reset();
+
+    CCoverageParserOptions ParserOptions = {};
+    auto Parser = ExitOnErr(CodeCoverage::load(Opts.Binaries, ParserOptions));
+    // Binaries are decoded by the first profile
+    CodeCoverage::free(ExitOnErr(Parser.coverage(*Profile)));
+    Phases.push_back(measure("coverage", "regions", Opts.Iterations, [] {}, [&] {
+        auto Files = ExitOnErr(Parser.coverage(*Profile));
+        uint64_t Regions = 0;
+        for (size_t Index = 0; Index < Files.files_count; Index++) {
+            Regions += Files.files[Index].regions_count;
+        }
+        CodeCoverage::free(Files);
+        return Regions;
+    }));
+
+    // Merge scaling with the number of threads. Copies of one result have the same files,
+    // so every file is a merge of MergedResults streams
+    auto Result = ExitOnErr(Parser.coverage(*Profile));
+    std::vector<CCoverageFiles> Results(Opts.MergedResults, Result);
+    uint64_t MergedRegions = 0;
+    for (size_t Index = 0; Index < Result.files_count; Index++) {
+        MergedRegions += Result.files[Index].regions_count * Opts.MergedResults;
+    }
+    unsigned Cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned Threads = 1;; Threads = std::min(Threads * 2, Cores)) {
+        ThreadPool Pool(Threads);
+        // Pool threads are started by the first merge
+        CodeCoverage::free(CodeCoverage::merge(Results, Pool));
+        Phases.push_back(measure("merge/" + std::to_string(Threads), "regions", Opts.Iterations, [] {}, [&] {
+            CodeCoverage::free(CodeCoverage::merge(Results, Pool));
+            return MergedRegions;
+        }));
+        if (Threads == Cores) {
+            break;
+        }
+    }
+    CodeCoverage::free(Result);
+
+    if (Opts.Indexed) {
+        std::unique_ptr<IndexedInstrProfReader> IndexedProfile;
+        Phases.push_back(measure("indexedRead", "bytes", Opts.Iterations, [&] { IndexedProfile.reset(); }, [&] {
+            IndexedProfile = ExitOnErr(readIndexedProfile(Opts.Profile));
+            return ProfileSize;
+        }));
+
+        std::optional<BinaryReaders> Readers;
+        std::unique_ptr<coverage::CoverageMapping> IndexedCoverage;
+        Phases.push_back(measure("indexedMap", "regions", Opts.Iterations, [&] {
+            IndexedCoverage.reset();
+            Readers.reset();
+            Readers.emplace(BinaryReaders::open(Opts.Binaries));
+        }, [&] {
+            IndexedCoverage = ExitOnErr(coverage::CoverageMapping::load(ArrayRef(Readers->Readers), *IndexedProfile));
+            return ExecutedRegions;
+        }));
+
+        auto IndexedFiles = IndexedCoverage->getUniqueSourceFiles();
+        Phases.push_back(measure("indexedFile", "segments", Opts.Iterations, [] {}, [&] {
+            uint64_t Segments = 0;
+            for (StringRef File : IndexedFiles) {
+                auto FileCoverage = IndexedCoverage->getCoverageForFile(File);
+                Segments += std::distance(FileCoverage.begin(), FileCoverage.end());
+            }
+            return Segments;
+        }));
+    }
+
+    print(Phases, Opts.CSV);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#!/bin/bash
+# Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+# This product includes software developed at Datadog (https://www.datadoghq.com/).
+# Copyright 2024-Present Datadog, Inc.
+
+# Generates synthetic coverage instrumented binary and its raw profile for the parser benchmarks.
+# Every source file has the same number of functions, every function has the same number of branches.
+# Each branch adds two regions (condition body and the gap after it) to the function region.
+#
+# Usage: generate.sh <output dir> [files] [functions per file] [branches per function] [executed percent]
+# CLANG should be the clang of the same LLVM version as the benchmarked parser.
+
+set -eo pipefail
+
+OUT="${1:?output directory is required}"
+FILES="${2:-100}"
+FUNCTIONS="${3:-50}"
+BRANCHES="${4:-8}"
+EXECUTED="${5:-50}"
+CLANG="${CLANG:-clang}"
+JOBS="${JOBS:-$(getconf _NPROCESSORS_ONLN)}"
+
+mkdir -p "$OUT/src" "$OUT/obj"
+rm -f "$OUT"/src/*.c "$OUT"/obj/*.o "$OUT"/bench.profraw
+
+awk -v out="$OUT/src" -v files="$FILES" -v functions="$FUNCTIONS" \
+    -v branches="$BRANCHES" -v executed="$EXECUTED" 'BEGIN {
+    main = out "/main.c"
+    for (file = 0; file < files; file++) {
+        source = sprintf("%s/file_%05d.c", out, file)
+        for (fn = 0; fn < functions; fn++) {
+            printf "int f_%d_%d(int x) {\n    int r = 0;\n", file, fn > source
+            for (branch = 0; branch < branches; branch++) {
+                printf "    if (x & %d) {\n        r += %d;\n    }\n", 2 ^ (branch % 30), branch + 1 > source
+            }
+            printf "    return r;\n}\n\n" > source
+            printf "int f_%d_%d(int x);\n", file, fn > main
+        }
+        close(source)
+    }
+    printf "\nint main(int argc, char **argv) {\n    int r = argc;\n" > main
+    # Executed functions are spread over all files. Arguments differ, so only a part of the branches is taken
+    for (file = 0; file < files; file++) {
+        for (fn = 0; fn < functions; fn++) {
+            if ((file * functions + fn) % 100 < executed) {
+                printf "    r += f_%d_%d(%d);\n", file, fn, file * 31 + fn > main
+            }
+        }
+    }
+    printf "    return r == 0;\n}\n" > main
+    close(main)
+}'
+
+export CLANG OUT FLAGS="-O0 -fprofile-instr-generate -fcoverage-mapping"
+find "$OUT/src" -name '*.c' -print0 | \
+    xargs -0 -P "$JOBS" -I{} sh -c '"$CLANG" $FLAGS -c "$1" -o "$OUT/obj/$(basename "$1" .c).o"' _ {}
+"$CLANG" $FLAGS -o "$OUT/bench" "$OUT"/obj/*.o
+LLVM_PROFILE_FILE="$OUT/bench.profraw" "$OUT/bench" > /dev/null || true
+
+echo "Binary: $OUT/bench ($(wc -c < "$OUT/bench") bytes)"
+echo "Profile: $OUT/bench.profraw ($(wc -c < "$OUT/bench.profraw") bytes)"
@@ -0,0 +1,347 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2025-Present Datadog, Inc.
+ */
+
+#if defined(__ELF__)
+
+#include "CCodeCoverageCollector.h"
+#include "symbols_query.h"
+#include <string.h>
+#include <elf.h>
+#include <link.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if __ELF_NATIVE_CLASS == 64
+#define ELF_NATIVE_CLASS ELFCLASS64
+#else
+#define ELF_NATIVE_CLASS ELFCLASS32
+#endif
+
+#define ELF_BLOOM_WORD_BITS (sizeof(ElfW(Addr)) * 8)
+
+#pragma mark dynamic symbols
+
+// Dynamic symbol tables of the loaded image
+typedef struct elf_dynamic_tables {
+    const ElfW(Sym)* _Nullable symtab;
+    const char* _Nullable strtab;
+    const uint32_t* _Nullable gnu_hash;
+    const uint32_t* _Nullable hash;
+} elf_dynamic_tables;
+
+// Loader relocates dynamic pointers in place on most platforms, but not on all of them (and not for vDSO)
+static inline const void* _Nonnull elf_dynamic_pointer(uintptr_t base, ElfW(Addr) pointer) {
+    return (const void*)(pointer < base ? base + pointer : pointer);
+}
+
+static bool elf_find_dynamic_tables(uintptr_t base, const ElfW(Phdr)* _Nonnull phdrs, size_t phnum,
+                                    elf_dynamic_tables* _Nonnull tables)
+{
+    memset(tables, 0, sizeof(*tables));
+    const ElfW(Dyn)* dynamic = NULL;
+    for (size_t i = 0; i < phnum; i++) {
+        if (phdrs[i].p_type == PT_DYNAMIC) {
+            dynamic = (const ElfW(Dyn)*)(base + phdrs[i].p_vaddr);
+            break;
+        }
+    }
+    if (dynamic == NULL) {
+        return false;
+    }
+    for (const ElfW(Dyn)* entry = dynamic; entry->d_tag != DT_NULL; entry++) {
+        switch (entry->d_tag) {
+        case DT_SYMTAB: tables->symtab = elf_dynamic_pointer(base, entry->d_un.d_ptr); break;
+        case DT_STRTAB: tables->strtab = elf_dynamic_pointer(base, entry->d_un.d_ptr); break;
+        case DT_GNU_HASH: tables->gnu_hash = elf_dynamic_pointer(base, entry->d_un.d_ptr); break;
+        case DT_HASH: tables->hash = elf_dynamic_pointer(base, entry->d_un.d_ptr); break;
+        default: break;
+        }
+    }
+    return tables->symtab != NULL && tables->strtab != NULL &&
+           (tables->gnu_hash != NULL || tables->hash != NULL);
+}
+
+static inline uint32_t elf_gnu_hash(const char* _Nonnull name) {
+    uint32_t hash = 5381;
+    for (const unsigned char* c = (const unsigned char*)name; *c != '\0'; c++) {
+        hash = hash * 33 + *c;
+    }
+    return hash;
+}
+
+static inline uint32_t elf_sysv_hash(const char* _Nonnull name) {
+    uint32_t hash = 0;
+    for (const unsigned char* c = (const unsigned char*)name; *c != '\0'; c++) {
+        hash = (hash << 4) + *c;
+        uint32_t high = hash & 0xF0000000;
+        if (high != 0) {
+            hash ^= high >> 24;
+        }
+        hash &= ~high;
+    }
+    return hash;
+}
+
+static inline bool elf_symbol_is_defined(const ElfW(Sym)* _Nonnull symbol) {
+    return symbol->st_shndx != SHN_UNDEF && symbol->st_value != 0;
+}
+
+static const ElfW(Sym)* _Nullable elf_gnu_hash_lookup(const elf_dynamic_tables* _Nonnull tables,
+                                                      const char* _Nonnull name)
+{
+    const uint32_t* table = tables->gnu_hash;
+    uint32_t buckets_count = table[0];
+    uint32_t symbols_offset = table[1];
+    uint32_t bloom_size = table[2];
+    uint32_t bloom_shift = table[3];
+    const ElfW(Addr)* bloom = (const ElfW(Addr)*)&table[4];
+    const uint32_t* buckets = (const uint32_t*)&bloom[bloom_size];
+    const uint32_t* chain = &buckets[buckets_count];
+
+    uint32_t hash = elf_gnu_hash(name);
+    // bloom filter rejects most of the missing names without touching the symbols
+    ElfW(Addr) word = bloom[(hash / ELF_BLOOM_WORD_BITS) % bloom_size];
+    ElfW(Addr) mask = ((ElfW(Addr))1 << (hash % ELF_BLOOM_WORD_BITS)) |
+                      ((ElfW(Addr))1 << ((hash >> bloom_shift) % ELF_BLOOM_WORD_BITS));
+    if ((word & mask) != mask) {
+        return NULL;
+    }
+    uint32_t index = buckets[hash % buckets_count];
+    if (index < symbols_offset) {
+        return NULL;
+    }
+    // chain hashes have the lowest bit set for the last symbol of the bucket
+    for (;; index++) {
+        uint32_t chain_hash = chain[index - symbols_offset];
+        const ElfW(Sym)* symbol = &tables->symtab[index];
+        if ((chain_hash | 1) == (hash | 1) &&
+            strcmp(name, tables->strtab + symbol->st_name) == 0 &&
+            elf_symbol_is_defined(symbol))
+        {
+            return symbol;
+        }
+        if (chain_hash & 1) {
+            return NULL;
+        }
+    }
+}
+
+static const ElfW(Sym)* _Nullable elf_sysv_hash_lookup(const elf_dynamic_tables* _Nonnull tables,
+                                                       const char* _Nonnull name)
+{
+    const uint32_t* table = tables->hash;
+    uint32_t buckets_count = table[0];
+    const uint32_t* buckets = &table[2];
+    const uint32_t* chain = &buckets[buckets_count];
+
+    for (uint32_t index = buckets[elf_sysv_hash(name) % buckets_count]; index != STN_UNDEF; index = chain[index]) {
+        const ElfW(Sym)* symbol = &tables->symtab[index];
+        if (strcmp(name, tables->strtab + symbol->st_name) == 0 && elf_symbol_is_defined(symbol)) {
+            return symbol;
+        }
+    }
+    return NULL;
+}
+
+static inline const void* _Nullable elf_find_dynamic_symbol(const elf_dynamic_tables* _Nonnull tables,
+                                                            const char* _Nonnull name,
+                                                            uintptr_t base)
+{
+    const ElfW(Sym)* symbol = tables->gnu_hash != NULL
+        ? elf_gnu_hash_lookup(tables, name)
+        : elf_sysv_hash_lookup(tables, name);
+    return symbol != NULL ? (const void*)(base + symbol->st_value) : NULL;
+}
+
+#pragma mark file symbols
+
+// Mapped image file. Section headers and .symtab aren't loaded to the memory
+typedef struct elf_file {
+    const char* _Nullable data;
+    size_t size;
+} elf_file;
+
+static bool elf_file_open(const char* _Nonnull path, elf_file* _Nonnull file) {
+    file->data = NULL;
+    file->size = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ElfW(Ehdr))) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    file->data = data;
+    file->size = (size_t)info.st_size;
+
+    const ElfW(Ehdr)* header = (const ElfW(Ehdr)*)file->data;
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 ||
+        header->e_ident[EI_CLASS] != ELF_NATIVE_CLASS ||
+        header->e_shentsize != sizeof(ElfW(Shdr)) ||
+        header->e_shoff + (size_t)header->e_shnum * sizeof(ElfW(Shdr)) > file->size ||
+        header->e_shstrndx >= header->e_shnum)
+    {
+        munmap((void*)file->data, file->size);
+        file->data = NULL;
+        return false;
+    }
+    return true;
+}
+
+static inline void elf_file_close(elf_file* _Nonnull file) {
+    if (file->data != NULL) {
+        munmap((void*)file->data, file->size);
+        file->data = NULL;
+    }
+}
+
+static inline const ElfW(Shdr)* _Nonnull elf_file_sections(const elf_file* _Nonnull file) {
+    const ElfW(Ehdr)* header = (const ElfW(Ehdr)*)file->data;
+    return (const ElfW(Shdr)*)(file->data + header->e_shoff);
+}
+
+static inline bool elf_file_section_is_valid(const elf_file* _Nonnull file, const ElfW(Shdr)* _Nonnull section) {
+    return section->sh_type != SHT_NOBITS && section->sh_offset + section->sh_size <= file->size;
+}
+
+static bool elf_file_has_profile_sections(const elf_file* _Nonnull file) {
+    const ElfW(Ehdr)* header = (const ElfW(Ehdr)*)file->data;
+    const ElfW(Shdr)* sections = elf_file_sections(file);
+    const ElfW(Shdr)* names = &sections[header->e_shstrndx];
+    if (!elf_file_section_is_valid(file, names)) {
+        return false;
+    }
+    bool has_counters = false, has_data = false;
+    for (ElfW(Half) i = 0; i < header->e_shnum; i++) {
+        if (sections[i].sh_name >= names->sh_size) {
+            continue;
+        }
+        const char* name = file->data + names->sh_offset + sections[i].sh_name;
+        if (strcmp(name, PROFILE_COUNTERS_SECTION) == 0) {
+            has_counters = true;
+        } else if (strcmp(name, PROFILE_DATA_SECTION) == 0) {
+            has_data = true;
+        }
+    }
+    return has_counters && has_data;
+}
+
+// Single pass over the .symtab of the file for the symbols which are not exported
+static void elf_file_find_symbols(const elf_file* _Nonnull file, symbols_query* _Nonnull query, uintptr_t base) {
+    const ElfW(Ehdr)* header = (const ElfW(Ehdr)*)file->data;
+    const ElfW(Shdr)* sections = elf_file_sections(file);
+    for (ElfW(Half) i = 0; i < header->e_shnum && query->found < query->count; i++) {
+        const ElfW(Shdr)* symtab = &sections[i];
+        if (symtab->sh_type != SHT_SYMTAB || symtab->sh_link >= header->e_shnum ||
+            !elf_file_section_is_valid(file, symtab) || !elf_file_section_is_valid(file, &sections[symtab->sh_link]))
+        {
+            continue;
+        }
+        const ElfW(Shdr)* strtab = &sections[symtab->sh_link];
+        const char* strings = file->data + strtab->sh_offset;
+        const ElfW(Sym)* symbols = (const ElfW(Sym)*)(file->data + symtab->sh_offset);
+        size_t count = symtab->sh_size / sizeof(ElfW(Sym));
+        for (size_t index = 0; index < count && query->found < query->count; index++) {
+            const ElfW(Sym)* symbol = &symbols[index];
+            // skip unnamed and undefined symbols
+            if (symbol->st_name == 0 || symbol->st_name >= strtab->sh_size || !elf_symbol_is_defined(symbol)) {
+                continue;
+            }
+            symbols_query_match(query, strings + symbol->st_name, base + symbol->st_value);
+        }
+    }
+}
+
+#pragma mark implementation
+
+const void* _Nullable coverage_find_symbol_in_elf_image(const char* _Nonnull symbol,
+                                                        uintptr_t base,
+                                                        const ElfW(Phdr)* _Nonnull phdrs,
+                                                        size_t phnum)
+{
+    elf_dynamic_tables tables;
+    if (symbol == NULL || phdrs == NULL || !elf_find_dynamic_tables(base, phdrs, phnum, &tables)) {
+        return NULL;
+    }
+    return elf_find_dynamic_symbol(&tables, symbol, base);
+}
+
+bool coverage_find_profile_symbols_in_elf_image(const char* _Nonnull path,
+                                                uintptr_t base,
+                                                const ElfW(Phdr)* _Nonnull phdrs,
+                                                size_t phnum,
+                                                CCoverageProfileSymbols* _Nonnull symbols)
+{
+    // same order as fields in CCoverageProfileSymbols
+    static const char* const names[] = {
+        "__llvm_profile_initialize",
+        "__llvm_profile_set_page_size",
+        "__llvm_profile_write_file",
+        "__llvm_profile_get_version",
+        "__llvm_profile_begin_counters",
+        "__llvm_profile_end_counters",
+        "__llvm_profile_begin_data",
+        "__llvm_profile_end_data",
+        "__llvm_profile_begin_bitmap",
+        "__llvm_profile_end_bitmap",
+        "__llvm_profile_begin_names",
+        "__llvm_profile_end_names"
+    };
+    const size_t count = sizeof(names) / sizeof(names[0]);
+    const void* results[sizeof(names) / sizeof(names[0])];
+
+    memset(symbols, 0, sizeof(*symbols));
+    elf_file file;
+    // section headers are only in the file. It also rejects vDSO and other images without a file
+    if (!elf_file_open(path, &file)) {
+        return false;
+    }
+    if (!elf_file_has_profile_sections(&file)) {
+        elf_file_close(&file);
+        return false;
+    }
+
+    symbols_query query;
+    symbols_query_init(&query, names, results, count);
+    // exported runtime is found with the hash tables
+    elf_dynamic_tables tables;
+    if (elf_find_dynamic_tables(base, phdrs, phnum, &tables)) {
+        for (size_t i = 0; i < count; i++) {
+            results[i] = elf_find_dynamic_symbol(&tables, names[i], base);
+            query.found += results[i] != NULL;
+        }
+    }
+    // runtime linked statically has hidden visibility. Look for the rest in the .symtab
+    if (query.found < count) {
+        elf_file_find_symbols(&file, &query, base);
+    }
+    elf_file_close(&file);
+
+    symbols->initialize = results[0];
+    symbols->set_page_size = results[1];
+    symbols->write_file = results[2];
+    symbols->get_version = results[3];
+    symbols->begin_counters = results[4];
+    symbols->end_counters = results[5];
+    symbols->begin_data = results[6];
+    symbols->end_data = results[7];
+    symbols->begin_bitmap = results[8];
+    symbols->end_bitmap = results[9];
+    symbols->begin_names = results[10];
+    symbols->end_names = results[11];
+    return true;
+}
+
+#endif
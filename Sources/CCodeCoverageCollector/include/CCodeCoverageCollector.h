@@ -7,7 +7,13 @@
 #pragma once
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#if defined(__APPLE__)
 #include <mach-o/loader.h>
+#elif defined(__ELF__)
+#include <link.h>
+#endif
 
 #if defined(__cplusplus)
 #define CC_EXPORT extern "C"
@@ -15,11 +21,66 @@
 #define CC_EXPORT extern
 #endif
 
+/// profile runtime symbols of the instrumented image. Missing symbols are NULL
+typedef struct CCoverageProfileSymbols {
+    const void* _Nullable initialize;
+    const void* _Nullable set_page_size;
+    const void* _Nullable write_file;
+    const void* _Nullable get_version;
+    const void* _Nullable begin_counters;
+    const void* _Nullable end_counters;
+    const void* _Nullable begin_data;
+    const void* _Nullable end_data;
+    const void* _Nullable begin_bitmap;
+    const void* _Nullable end_bitmap;
+    const void* _Nullable begin_names;
+    const void* _Nullable end_names;
+} CCoverageProfileSymbols;
+
+#if defined(__APPLE__)
+
 /// find symbol in image by name
 CC_EXPORT const void* _Nullable coverage_find_symbol_in_image(const char * _Nonnull symbol,
                                                               const struct mach_header * _Nonnull image,
                                                               intptr_t slide);
 
+/// find all symbols in image by names with a single symtab pass.
+/// results[i] is set to the address of symbols[i] or NULL. Returns count of found symbols
+CC_EXPORT size_t coverage_find_symbols_in_image(const char * _Nonnull const * _Nonnull symbols,
+                                                const void * _Nullable * _Nonnull results,
+                                                size_t count,
+                                                const struct mach_header * _Nonnull image,
+                                                intptr_t slide);
+
+/// check load commands of the image for __llvm_prf_cnts and __llvm_prf_data sections
+CC_EXPORT bool coverage_image_has_profile_sections(const struct mach_header * _Nonnull image);
+
+/// find profile runtime symbols in image.
+/// returns false without reading the symtab if image has no profile sections
+CC_EXPORT bool coverage_find_profile_symbols_in_image(const struct mach_header * _Nonnull image,
+                                                      intptr_t slide,
+                                                      CCoverageProfileSymbols * _Nonnull symbols);
+
+#elif defined(__ELF__)
+
+/// find dynamic symbol in loaded ELF image by name with the .gnu.hash or .hash table.
+/// base is the load address of the image (dlpi_addr)
+CC_EXPORT const void* _Nullable coverage_find_symbol_in_elf_image(const char * _Nonnull symbol,
+                                                                  uintptr_t base,
+                                                                  const ElfW(Phdr) * _Nonnull phdrs,
+                                                                  size_t phnum);
+
+/// find profile runtime symbols in loaded ELF image.
+/// Dynamic symbols are checked first. Hidden runtime symbols are read from the .symtab of the file.
+/// returns false if file has no profile sections
+CC_EXPORT bool coverage_find_profile_symbols_in_elf_image(const char * _Nonnull path,
+                                                          uintptr_t base,
+                                                          const ElfW(Phdr) * _Nonnull phdrs,
+                                                          size_t phnum,
+                                                          CCoverageProfileSymbols * _Nonnull symbols);
+
+#endif
+
 /// reset coverage counters for binary, LLVM 17. Swift 6.0..<6.1
 CC_EXPORT void coverage_reset_counters_llvm17(uint64_t profile_version,
                                               const void* _Nonnull func_counters_begin,
@@ -35,3 +96,103 @@ CC_EXPORT void coverage_reset_counters_llvm19(uint64_t profile_version,
                                               const void* _Nonnull func_data_end,
                                               const void* _Nonnull func_bitmap_begin,
                                               const void* _Nonnull func_bitmap_end);
+
+/// storage size of the raw profile header in 64 bit fields
+#define COVERAGE_PROFILE_HEADER_FIELDS 16
+/// max count of iovecs for the raw profile of one binary
+#define COVERAGE_PROFILE_IOVECS 8
+
+/// storage for the raw profile header of one binary
+typedef struct CCoverageProfileHeader {
+    uint64_t fields[COVERAGE_PROFILE_HEADER_FIELDS];
+} CCoverageProfileHeader;
+
+/// fill header and iovecs with the raw profile of binary, LLVM 17. Swift 6.0..<6.1
+/// Profile is the same as __llvm_profile_write_file writes, but without binary ids.
+/// returns count of iovecs or 0 if binary has value profile sites and has to be written by the runtime
+CC_EXPORT size_t coverage_profile_iovecs_llvm17(uint64_t profile_version,
+                                                const void* _Nonnull func_counters_begin,
+                                                const void* _Nonnull func_counters_end,
+                                                const void* _Nonnull func_data_begin,
+                                                const void* _Nonnull func_data_end,
+                                                const void* _Nonnull func_names_begin,
+                                                const void* _Nonnull func_names_end,
+                                                CCoverageProfileHeader* _Nonnull header,
+                                                struct iovec* _Nonnull iovecs);
+
+/// fill header and iovecs with the raw profile of binary, LLVM 19 Swift 6.1...6.2+
+/// Profile is the same as __llvm_profile_write_file writes, but without binary ids.
+/// returns count of iovecs or 0 if binary has value profile sites and has to be written by the runtime
+CC_EXPORT size_t coverage_profile_iovecs_llvm19(uint64_t profile_version,
+                                                const void* _Nonnull func_counters_begin,
+                                                const void* _Nonnull func_counters_end,
+                                                const void* _Nonnull func_data_begin,
+                                                const void* _Nonnull func_data_end,
+                                                const void* _Nonnull func_bitmap_begin,
+                                                const void* _Nonnull func_bitmap_end,
+                                                const void* _Nonnull func_names_begin,
+                                                const void* _Nonnull func_names_end,
+                                                CCoverageProfileHeader* _Nonnull header,
+                                                struct iovec* _Nonnull iovecs);
+
+/// write all iovecs to the file. iovecs are changed by partial writes.
+/// returns 0 or errno
+CC_EXPORT int coverage_profile_writev(int fd, struct iovec* _Nonnull iovecs, size_t count);
+
+/// "DDCOVSNP" in little endian
+#define COVERAGE_SNAPSHOT_MAGIC 0x504E53564F434444ULL
+#define COVERAGE_SNAPSHOT_VERSION 1
+
+/// Header of the in-memory counters snapshot of one binary.
+/// Followed by profile data records, counters and padding to 8 bytes.
+/// Snapshot of many binaries is a sequence of such blocks.
+typedef struct CCoverageSnapshotHeader {
+    uint64_t magic;
+    /// snapshot format version
+    uint64_t version;
+    /// __llvm_profile_get_version of the binary
+    uint64_t profile_version;
+    /// index of the binary in the covered binaries list
+    uint64_t binary_index;
+    /// size of profile data records in bytes
+    uint64_t data_size;
+    /// size of counters in bytes
+    uint64_t counters_size;
+    /// counters begin - data begin in the process memory. Counter pointers in data are relative
+    uint64_t counters_delta;
+} CCoverageSnapshotHeader;
+
+/// size of the counters snapshot of the binary in bytes
+CC_EXPORT size_t coverage_snapshot_size(const void* _Nonnull func_counters_begin,
+                                        const void* _Nonnull func_counters_end,
+                                        const void* _Nonnull func_data_begin,
+                                        const void* _Nonnull func_data_end);
+
+/// copy live counters of the binary to the buffer.
+/// returns written size or 0 if buffer is too small
+CC_EXPORT size_t coverage_snapshot_write(uint64_t profile_version,
+                                         uint64_t binary_index,
+                                         const void* _Nonnull func_counters_begin,
+                                         const void* _Nonnull func_counters_end,
+                                         const void* _Nonnull func_data_begin,
+                                         const void* _Nonnull func_data_end,
+                                         void* _Nonnull buffer,
+                                         size_t buffer_size);
+
+/// replace counters of the snapshot with the difference to the baseline snapshot of the same binaries.
+/// 64 bit counters are subtracted. Byte coverage counters are covered if they weren't covered in the baseline.
+/// returns false if snapshots have different layout
+CC_EXPORT bool coverage_snapshot_delta(const void* _Nonnull baseline, void* _Nonnull snapshot, size_t size);
+
+/// reset memory range to the value. Only 64 byte blocks with other values are written,
+/// so clean cache lines stay clean
+CC_EXPORT void coverage_reset_memory(void* _Nonnull begin, void* _Nonnull end, uint8_t value);
+
+/// check that all bytes of the memory range are equal to the value. Checks 64 byte blocks
+CC_EXPORT bool coverage_memory_is_clean(const void* _Nonnull begin, const void* _Nonnull end, uint8_t value);
+
+/// check that all counters of the binary have the reset value, so binary didn't execute code since the reset.
+/// Bitmap and value profile counters are updated only with the counters, so they aren't checked
+CC_EXPORT bool coverage_counters_are_reset(uint64_t profile_version,
+                                           const void* _Nonnull func_counters_begin,
+                                           const void* _Nonnull func_counters_end);
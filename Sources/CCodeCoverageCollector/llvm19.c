@@ -15,6 +15,12 @@
 // defines
 #define INSTR_PROF_DATA_ALIGNMENT 8
 #define VARIANT_MASK_BYTE_COVERAGE (0x1ULL << 60)
+#define INSTR_PROF_RAW_VERSION 10
+#define INSTR_PROF_RAW_MAGIC_64 (uint64_t)255 << 56 | (uint64_t)'l' << 48 | \
+       (uint64_t)'p' << 40 | (uint64_t)'r' << 32 | (uint64_t)'o' << 24 |  \
+        (uint64_t)'f' << 16 | (uint64_t)'r' << 8 | (uint64_t)129
+#define VARIANT_MASKS_ALL 0xffffffff00000000ULL
+#define GET_VERSION(V) ((V) & ~VARIANT_MASKS_ALL)
 
 typedef void *IntPtrT;
 
@@ -57,6 +63,34 @@ typedef struct __attribute__((aligned(INSTR_PROF_DATA_ALIGNMENT))) __llvm_profil
                     ConstantInt::get(llvm::Type::getInt32Ty(Ctx), NumBitmapBytes))
 } __llvm_profile_data;
 
+typedef struct __llvm_profile_header {
+    #define INSTR_PROF_RAW_HEADER(Type, Name, Initializer) Type Name;
+    
+    // These lines are copy-pasted from <llvm/ProfileData/InstrProfData.inc>
+    // Search for INSTR_PROF_RAW_HEADER macro
+    
+    INSTR_PROF_RAW_HEADER(uint64_t, Magic, __llvm_profile_get_magic())
+    INSTR_PROF_RAW_HEADER(uint64_t, Version, __llvm_profile_get_version())
+    INSTR_PROF_RAW_HEADER(uint64_t, BinaryIdsSize, __llvm_write_binary_ids(NULL))
+    INSTR_PROF_RAW_HEADER(uint64_t, NumData, NumData)
+    INSTR_PROF_RAW_HEADER(uint64_t, PaddingBytesBeforeCounters, PaddingBytesBeforeCounters)
+    INSTR_PROF_RAW_HEADER(uint64_t, NumCounters, NumCounters)
+    INSTR_PROF_RAW_HEADER(uint64_t, PaddingBytesAfterCounters, PaddingBytesAfterCounters)
+    INSTR_PROF_RAW_HEADER(uint64_t, NumBitmapBytes, NumBitmapBytes)
+    INSTR_PROF_RAW_HEADER(uint64_t, PaddingBytesAfterBitmapBytes, PaddingBytesAfterBitmapBytes)
+    INSTR_PROF_RAW_HEADER(uint64_t, NamesSize,  NamesSize)
+    INSTR_PROF_RAW_HEADER(uint64_t, CountersDelta,
+                          (uintptr_t)CountersBegin - (uintptr_t)DataBegin)
+    INSTR_PROF_RAW_HEADER(uint64_t, BitmapDelta,
+                          (uintptr_t)BitmapBegin - (uintptr_t)DataBegin)
+    INSTR_PROF_RAW_HEADER(uint64_t, NamesDelta, (uintptr_t)NamesBegin)
+    INSTR_PROF_RAW_HEADER(uint64_t, NumVTables, NumVTables)
+    INSTR_PROF_RAW_HEADER(uint64_t, VNamesSize, VNamesSize)
+    INSTR_PROF_RAW_HEADER(uint64_t, ValueKindLast, IPVK_Last)
+} __llvm_profile_header;
+
+_Static_assert(sizeof(__llvm_profile_header) <= sizeof(CCoverageProfileHeader), "Profile header is too big");
+
 typedef struct ValueProfNode * PtrToNodeT;
 typedef struct ValueProfNode {
     #define INSTR_PROF_VALUE_NODE(Type, LLVMType, Name, Initializer) Type Name;
@@ -74,6 +108,11 @@ typedef struct ValueProfNode {
 
 #pragma mark implementation
 
+// Raw profile sections are padded to 8 bytes
+static inline uint64_t profile_padding(uint64_t size) {
+    return (8 - size % 8) % 8;
+}
+
 void coverage_reset_counters_llvm19(uint64_t profile_version,
                                                      const void* _Nonnull func_counters_begin,
                                                      const void* _Nonnull func_counters_end,
@@ -94,15 +133,15 @@ void coverage_reset_counters_llvm19(uint64_t profile_version,
     char *I = llvm_profile_begin_counters_ptr();
     char *E = llvm_profile_end_counters_ptr();
     // properly select reset value
-    char ResetValue = (profile_version & VARIANT_MASK_BYTE_COVERAGE) ? 0xFF : 0;
-    // clear it
-    memset(I, ResetValue, E - I);
+    uint8_t ResetValue = (profile_version & VARIANT_MASK_BYTE_COVERAGE) ? 0xFF : 0;
+    // clear it. Blocks which are already reset are not written
+    coverage_reset_memory(I, E, ResetValue);
     
     // get region of bitmap data
     I = llvm_profile_begin_bitmap_ptr();
     E = llvm_profile_end_bitmap_ptr();
     // clear it
-    memset(I, 0x0, E - I);
+    coverage_reset_memory(I, E, 0x0);
 
     // iterate over profiling nodes in data
     const __llvm_profile_data *DataBegin = llvm_profile_begin_data();
@@ -132,9 +171,93 @@ void coverage_reset_counters_llvm19(uint64_t profile_version,
 
             // clear all counters in the list
             while (CurrentVNode) {
-                CurrentVNode->Count = 0;
+                if (CurrentVNode->Count) {
+                    CurrentVNode->Count = 0;
+                }
                 CurrentVNode = CurrentVNode->Next;
             }
         }
     }
 }
+
+size_t coverage_profile_iovecs_llvm19(uint64_t profile_version,
+                                      const void* _Nonnull func_counters_begin,
+                                      const void* _Nonnull func_counters_end,
+                                      const void* _Nonnull func_data_begin,
+                                      const void* _Nonnull func_data_end,
+                                      const void* _Nonnull func_bitmap_begin,
+                                      const void* _Nonnull func_bitmap_end,
+                                      const void* _Nonnull func_names_begin,
+                                      const void* _Nonnull func_names_end,
+                                      CCoverageProfileHeader* _Nonnull header,
+                                      struct iovec* _Nonnull iovecs)
+{
+    static const char Padding[8] = {0};
+
+    // convert pointers to the function pointers
+    char* const (*llvm_profile_begin_counters_ptr)(void) = func_counters_begin;
+    char* const (*llvm_profile_end_counters_ptr)(void) = func_counters_end;
+    const __llvm_profile_data* const (*llvm_profile_begin_data)(void) = func_data_begin;
+    const __llvm_profile_data* const (*llvm_profile_end_data)(void) = func_data_end;
+    char* const (*llvm_profile_begin_bitmap_ptr)(void) = func_bitmap_begin;
+    char* const (*llvm_profile_end_bitmap_ptr)(void) = func_bitmap_end;
+    const char* const (*llvm_profile_begin_names_ptr)(void) = func_names_begin;
+    const char* const (*llvm_profile_end_names_ptr)(void) = func_names_end;
+
+    // Layout of the other raw versions is unknown
+    if (GET_VERSION(profile_version) != INSTR_PROF_RAW_VERSION) {
+        return 0;
+    }
+
+    const __llvm_profile_data *DataBegin = llvm_profile_begin_data();
+    const __llvm_profile_data *DataEnd = llvm_profile_end_data();
+    const char *CountersBegin = llvm_profile_begin_counters_ptr();
+    const char *CountersEnd = llvm_profile_end_counters_ptr();
+    const char *BitmapBegin = llvm_profile_begin_bitmap_ptr();
+    const char *BitmapEnd = llvm_profile_end_bitmap_ptr();
+    const char *NamesBegin = llvm_profile_begin_names_ptr();
+    const char *NamesEnd = llvm_profile_end_names_ptr();
+
+    // Records with value sites need value profile data. Only the runtime can write it
+    for (const __llvm_profile_data *DI = DataBegin; DI < DataEnd; ++DI) {
+        for (uint32_t VKI = IPVK_First; VKI <= IPVK_Last; ++VKI) {
+            if (DI->NumValueSites[VKI] != 0) {
+                return 0;
+            }
+        }
+    }
+
+    // Same header as the runtime writes. Binary ids are optional and aren't written
+    __llvm_profile_header *Header = (__llvm_profile_header *)header->fields;
+    uint64_t CounterSize = (profile_version & VARIANT_MASK_BYTE_COVERAGE) ? 1 : sizeof(uint64_t);
+    Header->Magic = INSTR_PROF_RAW_MAGIC_64;
+    Header->Version = profile_version;
+    Header->BinaryIdsSize = 0;
+    Header->NumData = DataEnd - DataBegin;
+    Header->PaddingBytesBeforeCounters = 0;
+    Header->NumCounters = (CountersEnd - CountersBegin) / CounterSize;
+    Header->PaddingBytesAfterCounters = profile_padding(CountersEnd - CountersBegin);
+    Header->NumBitmapBytes = BitmapEnd - BitmapBegin;
+    Header->PaddingBytesAfterBitmapBytes = profile_padding(Header->NumBitmapBytes);
+    Header->NamesSize = NamesEnd - NamesBegin;
+    Header->CountersDelta = (uintptr_t)CountersBegin - (uintptr_t)DataBegin;
+    Header->BitmapDelta = (uintptr_t)BitmapBegin - (uintptr_t)DataBegin;
+    Header->NamesDelta = (uintptr_t)NamesBegin;
+    // Swift doesn't have vtable profiling
+    Header->NumVTables = 0;
+    Header->VNamesSize = 0;
+    Header->ValueKindLast = IPVK_Last;
+
+    // header, data, counters, bitmap, names. Each section is followed by padding
+    struct iovec *IOVecs = iovecs;
+    size_t Count = 0;
+    IOVecs[Count++] = (struct iovec){ Header, sizeof(*Header) };
+    IOVecs[Count++] = (struct iovec){ (void*)DataBegin, (char*)DataEnd - (char*)DataBegin };
+    IOVecs[Count++] = (struct iovec){ (void*)CountersBegin, CountersEnd - CountersBegin };
+    IOVecs[Count++] = (struct iovec){ (void*)Padding, Header->PaddingBytesAfterCounters };
+    IOVecs[Count++] = (struct iovec){ (void*)BitmapBegin, Header->NumBitmapBytes };
+    IOVecs[Count++] = (struct iovec){ (void*)Padding, Header->PaddingBytesAfterBitmapBytes };
+    IOVecs[Count++] = (struct iovec){ (void*)NamesBegin, Header->NamesSize };
+    IOVecs[Count++] = (struct iovec){ (void*)Padding, profile_padding(Header->NamesSize) };
+    return Count;
+}
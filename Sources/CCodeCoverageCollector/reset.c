@@ -0,0 +1,199 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2025-Present Datadog, Inc.
+ */
+
+#include "CCodeCoverageCollector.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Memory is checked and written by cache lines.
+// Lines which already have the reset value are only read, so they stay clean.
+#define RESET_BLOCK_SIZE 64
+
+#define RESET_INLINE static inline __attribute__((always_inline))
+
+// Same for all supported LLVM versions. From <llvm/ProfileData/InstrProfData.inc>
+#define VARIANT_MASK_BYTE_COVERAGE (0x1ULL << 60)
+
+#pragma mark block checks
+
+// Block checks return true if all bytes of the 64 byte block are equal to the value
+
+RESET_INLINE bool block_is_clean_SCALAR(const char* block, uint8_t value) {
+    uint64_t pattern = 0x0101010101010101ULL * value;
+    uint64_t diff = 0;
+    for (int i = 0; i < RESET_BLOCK_SIZE / 8; i++) {
+        uint64_t word;
+        memcpy(&word, block + i * 8, sizeof(word));
+        diff |= word ^ pattern;
+    }
+    return diff == 0;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define RESET_TARGET_SSE2 __attribute__((target("sse2")))
+#define RESET_TARGET_AVX2 __attribute__((target("avx2")))
+
+RESET_INLINE RESET_TARGET_SSE2 bool block_is_clean_SSE2(const char* block, uint8_t value) {
+    __m128i pattern = _mm_set1_epi8((char)value);
+    __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)block), pattern);
+    __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 16)), pattern);
+    __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 32)), pattern);
+    __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(block + 48)), pattern);
+    __m128i all = _mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d));
+    return _mm_movemask_epi8(all) == 0xFFFF;
+}
+
+RESET_INLINE RESET_TARGET_AVX2 bool block_is_clean_AVX2(const char* block, uint8_t value) {
+    __m256i pattern = _mm256_set1_epi8((char)value);
+    __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)block), pattern);
+    __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(block + 32)), pattern);
+    return _mm256_movemask_epi8(_mm256_and_si256(a, b)) == -1;
+}
+
+#elif defined(__aarch64__)
+
+#define RESET_TARGET_NEON
+
+RESET_INLINE bool block_is_clean_NEON(const char* block, uint8_t value) {
+    const uint8_t* bytes = (const uint8_t*)block;
+    uint8x16_t pattern = vdupq_n_u8(value);
+    uint8x16_t a = vceqq_u8(vld1q_u8(bytes), pattern);
+    uint8x16_t b = vceqq_u8(vld1q_u8(bytes + 16), pattern);
+    uint8x16_t c = vceqq_u8(vld1q_u8(bytes + 32), pattern);
+    uint8x16_t d = vceqq_u8(vld1q_u8(bytes + 48), pattern);
+    return vminvq_u8(vandq_u8(vandq_u8(a, b), vandq_u8(c, d))) == 0xFF;
+}
+
+#endif
+
+#define RESET_TARGET_SCALAR
+
+#pragma mark kernels
+
+// Writes only bytes which are different from the value.
+// Used for the unaligned head and tail of the range.
+RESET_INLINE void reset_bytes(char* begin, char* end, uint8_t value) {
+    for (char* byte = begin; byte < end; byte++) {
+        if ((uint8_t)*byte != value) {
+            *byte = (char)value;
+        }
+    }
+}
+
+// Checks bytes of the unaligned head and tail of the range
+RESET_INLINE bool bytes_are_clean(const char* begin, const char* end, uint8_t value) {
+    for (const char* byte = begin; byte < end; byte++) {
+        if ((uint8_t)*byte != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Generates kernel for the instruction set and its versions for both counter modes.
+// Counters are reset to 0xFF in byte coverage mode (VARIANT_MASK_BYTE_COVERAGE) and to 0 for 64 bit counters.
+// The value is a constant in the mode versions, so the block check is specialized for it.
+// Clean check stops on the first block which has other value.
+#define RESET_KERNELS(isa)                                                                      \
+    RESET_INLINE RESET_TARGET_##isa void reset_##isa(char* begin, char* end, uint8_t value) {  \
+        uintptr_t aligned = ((uintptr_t)begin + RESET_BLOCK_SIZE - 1) & ~(uintptr_t)(RESET_BLOCK_SIZE - 1); \
+        char* block = (uintptr_t)end < aligned ? end : (char*)aligned;                         \
+        reset_bytes(begin, block, value);                                                      \
+        for (; end - block >= RESET_BLOCK_SIZE; block += RESET_BLOCK_SIZE) {                   \
+            if (!block_is_clean_##isa(block, value)) {                                         \
+                memset(block, value, RESET_BLOCK_SIZE);                                        \
+            }                                                                                  \
+        }                                                                                      \
+        reset_bytes(block, end, value);                                                        \
+    }                                                                                          \
+    static RESET_TARGET_##isa void reset_##isa##_byte_coverage(char* begin, char* end) {      \
+        reset_##isa(begin, end, 0xFF);                                                         \
+    }                                                                                          \
+    static RESET_TARGET_##isa void reset_##isa##_counters(char* begin, char* end) {           \
+        reset_##isa(begin, end, 0x00);                                                         \
+    }                                                                                          \
+    static RESET_TARGET_##isa void reset_##isa##_any(char* begin, char* end, uint8_t value) { \
+        reset_##isa(begin, end, value);                                                        \
+    }                                                                                          \
+    static RESET_TARGET_##isa bool is_clean_##isa(const char* begin, const char* end, uint8_t value) { \
+        uintptr_t aligned = ((uintptr_t)begin + RESET_BLOCK_SIZE - 1) & ~(uintptr_t)(RESET_BLOCK_SIZE - 1); \
+        const char* block = (uintptr_t)end < aligned ? end : (const char*)aligned;             \
+        if (!bytes_are_clean(begin, block, value)) {                                           \
+            return false;                                                                      \
+        }                                                                                      \
+        for (; end - block >= RESET_BLOCK_SIZE; block += RESET_BLOCK_SIZE) {                   \
+            if (!block_is_clean_##isa(block, value)) {                                         \
+                return false;                                                                  \
+            }                                                                                  \
+        }                                                                                      \
+        return bytes_are_clean(block, end, value);                                             \
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+RESET_KERNELS(SSE2)
+RESET_KERNELS(AVX2)
+#elif defined(__aarch64__)
+RESET_KERNELS(NEON)
+#else
+RESET_KERNELS(SCALAR)
+#endif
+
+#pragma mark implementation
+
+#define RESET_DISPATCH(isa, begin, end, value)                  \
+    switch (value) {                                            \
+    case 0xFF: reset_##isa##_byte_coverage(begin, end); break;  \
+    case 0x00: reset_##isa##_counters(begin, end); break;       \
+    default: reset_##isa##_any(begin, end, value); break;       \
+    }
+
+void coverage_reset_memory(void* _Nonnull begin, void* _Nonnull end, uint8_t value) {
+    if (begin >= end) {
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        RESET_DISPATCH(AVX2, begin, end, value)
+    } else {
+        RESET_DISPATCH(SSE2, begin, end, value)
+    }
+#elif defined(__aarch64__)
+    RESET_DISPATCH(NEON, begin, end, value)
+#else
+    RESET_DISPATCH(SCALAR, begin, end, value)
+#endif
+}
+
+bool coverage_memory_is_clean(const void* _Nonnull begin, const void* _Nonnull end, uint8_t value) {
+    if (begin >= end) {
+        return true;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_cpu_supports("avx2") ? is_clean_AVX2(begin, end, value) : is_clean_SSE2(begin, end, value);
+#elif defined(__aarch64__)
+    return is_clean_NEON(begin, end, value);
+#else
+    return is_clean_SCALAR(begin, end, value);
+#endif
+}
+
+bool coverage_counters_are_reset(uint64_t profile_version,
+                                 const void* _Nonnull func_counters_begin,
+                                 const void* _Nonnull func_counters_end)
+{
+    // convert pointers to the function pointers
+    char* const (*llvm_profile_begin_counters_ptr)(void) = func_counters_begin;
+    char* const (*llvm_profile_end_counters_ptr)(void) = func_counters_end;
+    // byte coverage counters are reset to 0xFF, 64 bit counters to 0
+    uint8_t ResetValue = (profile_version & VARIANT_MASK_BYTE_COVERAGE) ? 0xFF : 0;
+    return coverage_memory_is_clean(llvm_profile_begin_counters_ptr(), llvm_profile_end_counters_ptr(), ResetValue);
+}
@@ -0,0 +1,130 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2025-Present Datadog, Inc.
+ */
+
+#include "CCodeCoverageCollector.h"
+#include <string.h>
+
+static inline size_t snapshot_size(size_t data_size, size_t counters_size) {
+    size_t size = sizeof(CCoverageSnapshotHeader) + data_size + counters_size;
+    // align to 8 bytes, so the next header is aligned too
+    return (size + 7) & ~(size_t)7;
+}
+
+size_t coverage_snapshot_size(const void* _Nonnull func_counters_begin,
+                              const void* _Nonnull func_counters_end,
+                              const void* _Nonnull func_data_begin,
+                              const void* _Nonnull func_data_end)
+{
+    // convert pointers to the function pointers
+    const char* (*llvm_profile_begin_counters)(void) = func_counters_begin;
+    const char* (*llvm_profile_end_counters)(void) = func_counters_end;
+    const char* (*llvm_profile_begin_data)(void) = func_data_begin;
+    const char* (*llvm_profile_end_data)(void) = func_data_end;
+
+    return snapshot_size(llvm_profile_end_data() - llvm_profile_begin_data(),
+                         llvm_profile_end_counters() - llvm_profile_begin_counters());
+}
+
+size_t coverage_snapshot_write(uint64_t profile_version,
+                               uint64_t binary_index,
+                               const void* _Nonnull func_counters_begin,
+                               const void* _Nonnull func_counters_end,
+                               const void* _Nonnull func_data_begin,
+                               const void* _Nonnull func_data_end,
+                               void* _Nonnull buffer,
+                               size_t buffer_size)
+{
+    // convert pointers to the function pointers
+    const char* (*llvm_profile_begin_counters)(void) = func_counters_begin;
+    const char* (*llvm_profile_end_counters)(void) = func_counters_end;
+    const char* (*llvm_profile_begin_data)(void) = func_data_begin;
+    const char* (*llvm_profile_end_data)(void) = func_data_end;
+
+    // get regions of data and counters
+    const char* counters_begin = llvm_profile_begin_counters();
+    const char* counters_end = llvm_profile_end_counters();
+    const char* data_begin = llvm_profile_begin_data();
+    const char* data_end = llvm_profile_end_data();
+
+    size_t size = snapshot_size(data_end - data_begin, counters_end - counters_begin);
+    if (buffer_size < size) {
+        return 0;
+    }
+
+    CCoverageSnapshotHeader header = {
+        .magic = COVERAGE_SNAPSHOT_MAGIC,
+        .version = COVERAGE_SNAPSHOT_VERSION,
+        .profile_version = profile_version,
+        .binary_index = binary_index,
+        .data_size = data_end - data_begin,
+        .counters_size = counters_end - counters_begin,
+        .counters_delta = (uint64_t)(counters_begin - data_begin)
+    };
+
+    // copy header, data records and live counters. Data records are static
+    char* out = buffer;
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    memcpy(out, data_begin, header.data_size);
+    out += header.data_size;
+    memcpy(out, counters_begin, header.counters_size);
+    out += header.counters_size;
+    // zero the padding
+    memset(out, 0, (char*)buffer + size - out);
+    return size;
+}
+
+// Same for all supported LLVM versions. From <llvm/ProfileData/InstrProfData.inc>
+#define VARIANT_MASK_BYTE_COVERAGE (0x1ULL << 60)
+
+// 64 bit counters grow, so the difference is the count in the window.
+// Counters reset by startCoverageGathering can be below the baseline, difference is clamped to 0 then.
+// Select without branches, so the loop is still vectorized
+static void counters_delta(const uint64_t* restrict baseline, uint64_t* restrict counters, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        counters[i] = counters[i] > baseline[i] ? counters[i] - baseline[i] : 0;
+    }
+}
+
+// Byte coverage counter is 0 if covered and 0xFF otherwise.
+// Counter is covered in the window if it wasn't covered in the baseline
+static void byte_counters_delta(const uint8_t* restrict baseline, uint8_t* restrict counters, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        counters[i] = (counters[i] == 0 && baseline[i] != 0) ? 0 : 0xFF;
+    }
+}
+
+bool coverage_snapshot_delta(const void* _Nonnull baseline, void* _Nonnull snapshot, size_t size) {
+    const char* base = baseline;
+    char* live = snapshot;
+    size_t offset = 0;
+    while (offset + sizeof(CCoverageSnapshotHeader) <= size) {
+        CCoverageSnapshotHeader base_header, live_header;
+        memcpy(&base_header, base + offset, sizeof(base_header));
+        memcpy(&live_header, live + offset, sizeof(live_header));
+        // sections are static, so snapshots of the same binaries have the same layout
+        if (memcmp(&base_header, &live_header, sizeof(base_header)) != 0 ||
+            live_header.magic != COVERAGE_SNAPSHOT_MAGIC)
+        {
+            return false;
+        }
+        size_t block = snapshot_size(live_header.data_size, live_header.counters_size);
+        if (offset + block > size) {
+            return false;
+        }
+        // counters follow 8 byte aligned header and data records
+        size_t counters = offset + sizeof(CCoverageSnapshotHeader) + live_header.data_size;
+        if (live_header.profile_version & VARIANT_MASK_BYTE_COVERAGE) {
+            byte_counters_delta((const uint8_t*)(base + counters), (uint8_t*)(live + counters),
+                                live_header.counters_size);
+        } else {
+            counters_delta((const uint64_t*)(base + counters), (uint64_t*)(live + counters),
+                           live_header.counters_size / sizeof(uint64_t));
+        }
+        offset += block;
+    }
+    return offset == size;
+}
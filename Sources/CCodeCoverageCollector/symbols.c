@@ -4,14 +4,72 @@
  * Copyright 2025-Present Datadog, Inc.
  */
 
+#if defined(__APPLE__)
+
 #include "CCodeCoverageCollector.h"
+#include "symbols_query.h"
 #include <string.h>
 #include <mach-o/loader.h>
 #include <mach-o/nlist.h>
 
-static inline const void* _Nullable find_symbol_32bit(const char* _Nonnull symbol,
-                                                      const struct mach_header* _Nonnull image,
-                                                      intptr_t slide)
+static inline bool section_is_profile(const char* _Nonnull sectname) {
+    return strncmp(sectname, PROFILE_COUNTERS_SECTION, sizeof(((struct section*)0)->sectname)) == 0 ||
+           strncmp(sectname, PROFILE_DATA_SECTION, sizeof(((struct section*)0)->sectname)) == 0;
+}
+
+static inline bool has_profile_sections_32bit(const struct mach_header* _Nonnull image) {
+    bool has_counters = false, has_data = false;
+    struct segment_command *cur_seg_cmd;
+    uintptr_t cur = (uintptr_t)(image + 1); // skip header
+    // Iterate through segment commands and their sections
+    for (uint32_t i = 0; i < image->ncmds; i++, cur += cur_seg_cmd->cmdsize) {
+        cur_seg_cmd = (struct segment_command *)cur;
+        if (cur_seg_cmd->cmd != LC_SEGMENT) {
+            continue;
+        }
+        struct section *sect = (struct section *)(cur_seg_cmd + 1);
+        for (uint32_t j = 0; j < cur_seg_cmd->nsects; j++, sect++) {
+            if (!section_is_profile(sect->sectname)) {
+                continue;
+            }
+            if (strncmp(sect->sectname, PROFILE_COUNTERS_SECTION, sizeof(sect->sectname)) == 0) {
+                has_counters = true;
+            } else {
+                has_data = true;
+            }
+        }
+    }
+    return has_counters && has_data;
+}
+
+static inline bool has_profile_sections_64bit(const struct mach_header_64* _Nonnull image) {
+    bool has_counters = false, has_data = false;
+    struct segment_command_64 *cur_seg_cmd;
+    uintptr_t cur = (uintptr_t)(image + 1); // skip header
+    // Iterate through segment commands and their sections
+    for (uint32_t i = 0; i < image->ncmds; i++, cur += cur_seg_cmd->cmdsize) {
+        cur_seg_cmd = (struct segment_command_64 *)cur;
+        if (cur_seg_cmd->cmd != LC_SEGMENT_64) {
+            continue;
+        }
+        struct section_64 *sect = (struct section_64 *)(cur_seg_cmd + 1);
+        for (uint32_t j = 0; j < cur_seg_cmd->nsects; j++, sect++) {
+            if (!section_is_profile(sect->sectname)) {
+                continue;
+            }
+            if (strncmp(sect->sectname, PROFILE_COUNTERS_SECTION, sizeof(sect->sectname)) == 0) {
+                has_counters = true;
+            } else {
+                has_data = true;
+            }
+        }
+    }
+    return has_counters && has_data;
+}
+
+static inline void find_symbols_32bit(symbols_query* _Nonnull query,
+                                      const struct mach_header* _Nonnull image,
+                                      intptr_t slide)
 {
     struct symtab_command *symtab_cmd = NULL;
     struct segment_command *linkedit_segment = NULL;
@@ -35,7 +93,7 @@ static inline const void* _Nullable find_symbol_32bit(const char* _Nonnull symbo
 
     // check that we found them
     if (!symtab_cmd || !linkedit_segment || !text_segment) {
-        return NULL;
+        return;
     }
 
     // calculate pointers to the symtab list start and symtab text start
@@ -44,27 +102,26 @@ static inline const void* _Nullable find_symbol_32bit(const char* _Nonnull symbo
     char *strtab = (char *)(linkedit_base + symtab_cmd->stroff);
 
     struct nlist *sym;
-    int index;
-    // iterate through symbols and search for our symbol
-    for (index = 0, sym = symtab; index < symtab_cmd->nsyms; index += 1, sym += 1) {
-        if (sym->n_un.n_strx != 0 && strcmp(symbol, strtab + sym->n_un.n_strx) == 0) {
-            // Calculate its address
-            uint64_t address = slide + sym->n_value;
-            // arm thumb needs first address bit changed
-            if (sym->n_desc & N_ARM_THUMB_DEF) {
-                return (void *)(address | 1);
-            } else {
-                return (void *)(address);
-            }
+    uint32_t index;
+    // iterate through symbols once and search for all wanted symbols
+    for (index = 0, sym = symtab; index < symtab_cmd->nsyms && query->found < query->count; index += 1, sym += 1) {
+        // skip unnamed and undefined symbols
+        if (sym->n_un.n_strx == 0 || (sym->n_type & N_TYPE) == N_UNDF) {
+            continue;
+        }
+        // Calculate its address
+        uint64_t address = slide + sym->n_value;
+        // arm thumb needs first address bit changed
+        if (sym->n_desc & N_ARM_THUMB_DEF) {
+            address |= 1;
         }
+        symbols_query_match(query, strtab + sym->n_un.n_strx, address);
     }
-    // not found
-    return NULL;
 }
 
-static inline const void* _Nullable find_symbol_64bit(const char* _Nonnull symbol,
-                                                      const struct mach_header_64* _Nonnull image,
-                                                      intptr_t slide)
+static inline void find_symbols_64bit(symbols_query* _Nonnull query,
+                                      const struct mach_header_64* _Nonnull image,
+                                      intptr_t slide)
 {
     struct symtab_command *symtab_cmd = NULL;
     struct segment_command_64 *linkedit_segment = NULL;
@@ -88,7 +145,7 @@ static inline const void* _Nullable find_symbol_64bit(const char* _Nonnull symbo
 
     // check that we found them
     if (!symtab_cmd || !linkedit_segment || !text_segment) {
-        return NULL;
+        return;
     }
 
     // calculate pointers to the symtab list start and symtab text start
@@ -97,22 +154,40 @@ static inline const void* _Nullable find_symbol_64bit(const char* _Nonnull symbo
     char *strtab = (char *)(linkedit_base + symtab_cmd->stroff);
 
     struct nlist_64 *sym;
-    int index;
-    // iterate through symbols and search for our symbol
-    for (index = 0, sym = symtab; index < symtab_cmd->nsyms; index += 1, sym += 1) {
-        if (sym->n_un.n_strx != 0 && strcmp(symbol, strtab + sym->n_un.n_strx) == 0) {
-            // Calculate its address
-            uint64_t address = slide + sym->n_value;
-            // arm thumb needs first address bit changed
-            if (sym->n_desc & N_ARM_THUMB_DEF) {
-                return (void *)(address | 1);
-            } else {
-                return (void *)(address);
-            }
+    uint32_t index;
+    // iterate through symbols once and search for all wanted symbols
+    for (index = 0, sym = symtab; index < symtab_cmd->nsyms && query->found < query->count; index += 1, sym += 1) {
+        // skip unnamed and undefined symbols
+        if (sym->n_un.n_strx == 0 || (sym->n_type & N_TYPE) == N_UNDF) {
+            continue;
         }
+        // Calculate its address
+        uint64_t address = slide + sym->n_value;
+        // arm thumb needs first address bit changed
+        if (sym->n_desc & N_ARM_THUMB_DEF) {
+            address |= 1;
+        }
+        symbols_query_match(query, strtab + sym->n_un.n_strx, address);
+    }
+}
+
+size_t coverage_find_symbols_in_image(const char* _Nonnull const* _Nonnull symbols,
+                                      const void* _Nullable * _Nonnull results,
+                                      size_t count,
+                                      const struct mach_header* _Nonnull image,
+                                      intptr_t slide)
+{
+    symbols_query query;
+    symbols_query_init(&query, symbols, results, count);
+    if (image == NULL || count == 0) {
+        return 0;
+    }
+    if (image->magic == MH_MAGIC_64) {
+        find_symbols_64bit(&query, (const struct mach_header_64*)image, slide);
+    } else {
+        find_symbols_32bit(&query, image, slide);
     }
-    // not found
-    return NULL;
+    return query.found;
 }
 
 const void* _Nullable coverage_find_symbol_in_image(const char* _Nonnull symbol,
@@ -122,7 +197,60 @@ const void* _Nullable coverage_find_symbol_in_image(const char* _Nonnull symbol,
     if ((image == NULL) || (symbol == NULL)) {
         return NULL;
     }
+    const void* result = NULL;
+    coverage_find_symbols_in_image(&symbol, &result, 1, image, slide);
+    return result;
+}
+
+bool coverage_image_has_profile_sections(const struct mach_header* _Nonnull image) {
+    if (image == NULL) {
+        return false;
+    }
     return image->magic == MH_MAGIC_64
-        ? find_symbol_64bit(symbol, (const struct mach_header_64*)image, slide)
-        : find_symbol_32bit(symbol, image, slide);
+        ? has_profile_sections_64bit((const struct mach_header_64*)image)
+        : has_profile_sections_32bit(image);
 }
+
+bool coverage_find_profile_symbols_in_image(const struct mach_header* _Nonnull image,
+                                            intptr_t slide,
+                                            CCoverageProfileSymbols* _Nonnull symbols)
+{
+    // same order as fields in CCoverageProfileSymbols
+    static const char* const names[] = {
+        "___llvm_profile_initialize",
+        "___llvm_profile_set_page_size",
+        "___llvm_profile_write_file",
+        "___llvm_profile_get_version",
+        "___llvm_profile_begin_counters",
+        "___llvm_profile_end_counters",
+        "___llvm_profile_begin_data",
+        "___llvm_profile_end_data",
+        "___llvm_profile_begin_bitmap",
+        "___llvm_profile_end_bitmap",
+        "___llvm_profile_begin_names",
+        "___llvm_profile_end_names"
+    };
+    const void* results[sizeof(names) / sizeof(names[0])];
+
+    memset(symbols, 0, sizeof(*symbols));
+    // skip not instrumented images without reading the symtab
+    if (!coverage_image_has_profile_sections(image)) {
+        return false;
+    }
+    coverage_find_symbols_in_image(names, results, sizeof(names) / sizeof(names[0]), image, slide);
+    symbols->initialize = results[0];
+    symbols->set_page_size = results[1];
+    symbols->write_file = results[2];
+    symbols->get_version = results[3];
+    symbols->begin_counters = results[4];
+    symbols->end_counters = results[5];
+    symbols->begin_data = results[6];
+    symbols->end_data = results[7];
+    symbols->begin_bitmap = results[8];
+    symbols->end_bitmap = results[9];
+    symbols->begin_names = results[10];
+    symbols->end_names = results[11];
+    return true;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2025-Present Datadog, Inc.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Section names of the profile counters and data records
+#define PROFILE_COUNTERS_SECTION "__llvm_prf_cnts"
+#define PROFILE_DATA_SECTION "__llvm_prf_data"
+
+// Wanted symbols for the single symtab pass.
+// Symbols are compared with the common prefix first. Most of symtab entries
+// differ in the first bytes, so only few of them are compared with each name.
+typedef struct symbols_query {
+    const char* _Nonnull const* _Nonnull names;
+    const void* _Nullable * _Nonnull results;
+    size_t count;
+    size_t found;
+    size_t prefix_length;
+} symbols_query;
+
+static inline void symbols_query_init(symbols_query* _Nonnull query,
+                                      const char* _Nonnull const* _Nonnull names,
+                                      const void* _Nullable * _Nonnull results,
+                                      size_t count)
+{
+    query->names = names;
+    query->results = results;
+    query->count = count;
+    query->found = 0;
+    // common prefix of all names
+    query->prefix_length = count > 0 ? strlen(names[0]) : 0;
+    for (size_t i = 0; i < count; i++) {
+        results[i] = NULL;
+        size_t length = 0;
+        while (length < query->prefix_length && names[i][length] == names[0][length]) {
+            length++;
+        }
+        query->prefix_length = length;
+    }
+}
+
+// Checks symbol name against the wanted names and saves the address if it's found
+static inline void symbols_query_match(symbols_query* _Nonnull query, const char* _Nonnull name,
+                                       uint64_t address)
+{
+    // early exit for the names without common prefix
+    if (strncmp(name, query->names[0], query->prefix_length) != 0) {
+        return;
+    }
+    const char* suffix = name + query->prefix_length;
+    for (size_t i = 0; i < query->count; i++) {
+        if (query->results[i] == NULL && strcmp(suffix, query->names[i] + query->prefix_length) == 0) {
+            query->results[i] = (const void*)address;
+            query->found++;
+            return;
+        }
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2025-Present Datadog, Inc.
+ */
+
+#include "CCodeCoverageCollector.h"
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+int coverage_profile_writev(int fd, struct iovec* _Nonnull iovecs, size_t count) {
+    while (count > 0) {
+        // skip empty sections, writev fails on the zero count
+        if (iovecs->iov_len == 0) {
+            iovecs++;
+            count--;
+            continue;
+        }
+        ssize_t written = writev(fd, iovecs, count < IOV_MAX ? (int)count : IOV_MAX);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        // drop written iovecs and move the partially written one
+        size_t left = (size_t)written;
+        while (count > 0 && left >= iovecs->iov_len) {
+            left -= iovecs->iov_len;
+            iovecs++;
+            count--;
+        }
+        if (count > 0) {
+            iovecs->iov_base = (char*)iovecs->iov_base + left;
+            iovecs->iov_len -= left;
+        }
+    }
+    return 0;
+}
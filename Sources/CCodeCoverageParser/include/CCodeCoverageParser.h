@@ -34,19 +34,113 @@ typedef struct CCoverageSegment {
     bool IsGapRegion;
 } CCoverageSegment;
 
-// One covered file
+// This is a copy of CCoverageSnapshotHeader from the collector.
+// Header of the in-memory counters snapshot of one binary.
+// Followed by profile data records, counters and padding to 8 bytes.
+#define COVERAGE_SNAPSHOT_MAGIC 0x504E53564F434444ULL
+#define COVERAGE_SNAPSHOT_VERSION 1
+
+typedef struct CCoverageSnapshotHeader {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t profile_version;
+    uint64_t binary_index;
+    uint64_t data_size;
+    uint64_t counters_size;
+    uint64_t counters_delta;
+} CCoverageSnapshotHeader;
+
+// One covered file. Covered regions are stored by columns, element i of every array is region i.
+// Regions are sorted by location (start, then end). Regions of one parsed profile don't overlap.
+// Merged results sum regions with the same location, but regions of different profiles may overlap.
+// Arrays are NULL if there are no regions
 typedef struct CCoverageFile {
     const char* _Nonnull name;
-    CCoverageSegment* _Nullable segments;
-    size_t segments_count;
+    size_t regions_count;
+    const uint32_t* _Nullable start_lines;
+    const uint32_t* _Nullable start_columns;
+    const uint32_t* _Nullable end_lines;
+    const uint32_t* _Nullable end_columns;
+    // execution counts of the regions. Always non zero
+    const uint64_t* _Nullable counts;
 } CCoverageFile;
 
-// list of files covered in this report
+// list of files covered in this report.
+// files, region columns and names are in one memory block which starts at files.
+// block should be freed with free_result of the parser
 typedef struct CCoverageFiles {
     CCoverageFile* _Nullable files;
     size_t files_count;
+    // size of the memory block in bytes
+    size_t size;
 } CCoverageFiles;
 
+// Line coverage of one file. Line N is bit (N - 1) % 64 of word (N - 1) / 64 in bitsets
+// and element N - 1 in counts. Lines after lines_count are not coverable.
+typedef struct CCoverageFileLines {
+    const char* _Nonnull name;
+    // last coverable line
+    uint32_t lines_count;
+    // lines with code. (lines_count + 63) / 64 words
+    const uint64_t* _Nonnull coverable;
+    // executed lines. (lines_count + 63) / 64 words
+    const uint64_t* _Nonnull covered;
+    // execution counts of the lines. NULL if counts weren't requested
+    const uint64_t* _Nullable counts;
+} CCoverageFileLines;
+
+// list of files with line coverage.
+// files, bitsets, counts and names are in one memory block which starts at files.
+// block should be freed with free_lines_result of the parser
+typedef struct CCoverageLines {
+    CCoverageFileLines* _Nullable files;
+    size_t files_count;
+    // size of the memory block in bytes
+    size_t size;
+} CCoverageLines;
+
+// line coverage command result
+typedef struct CCoverageLinesResult {
+    bool is_error;
+    union {
+        CCoverageLines lines;
+        const char* _Nullable error;
+    };
+} CCoverageLinesResult;
+
+// Executed function. Read from the profile counters without evaluation of the regions
+typedef struct CCoverageFunction {
+    // function name without the file prefix of local functions
+    const char* _Nonnull name;
+    // structural hash of the function
+    uint64_t hash;
+    // indexes in the files of CCoverageTouched
+    const uint32_t* _Nullable files;
+    size_t files_count;
+} CCoverageFunction;
+
+// Files and functions with executed counters.
+// files, functions, file indexes and names are in one memory block which starts at files.
+// block should be freed with free_touched_result of the parser
+typedef struct CCoverageTouched {
+    // file names sorted by name
+    const char* _Nonnull const* _Nullable files;
+    size_t files_count;
+    CCoverageFunction* _Nullable functions;
+    size_t functions_count;
+    // size of the memory block in bytes
+    size_t size;
+} CCoverageTouched;
+
+// touched files command result
+typedef struct CCoverageTouchedResult {
+    bool is_error;
+    union {
+        CCoverageTouched touched;
+        const char* _Nullable error;
+    };
+} CCoverageTouchedResult;
+
 // coverage parsing command result
 typedef struct CCoverageFilesResult {
     bool is_error;
@@ -56,12 +150,147 @@ typedef struct CCoverageFilesResult {
     };
 } CCoverageFilesResult;
 
+// Sums counters of many profiles and calculates coverage once
+struct CCoverageAccumulator {
+    // add counters from profraw file. returns error string or NULL
+    const char* _Nullable (* _Nonnull add_file)(struct CCoverageAccumulator* _Nonnull self,
+                                                const char* _Nonnull profraw_file);
+    // add counters from profile in memory. returns error string or NULL
+    const char* _Nullable (* _Nonnull add_buffer)(struct CCoverageAccumulator* _Nonnull self,
+                                                  const void* _Nonnull data, size_t size);
+    // calculate coverage for all added profiles
+    CCoverageFilesResult (* _Nonnull finalize)(const struct CCoverageAccumulator* _Nonnull self);
+    // delete accumulator object
+    void (* _Nonnull destroy)(struct CCoverageAccumulator* _Nonnull self);
+};
+
+// max count of segments in one segments callback of the visitor
+#define COVERAGE_VISITOR_BATCH_SIZE 256
+
+// Streaming consumer of the coverage. Files are visited one by one on the calling thread,
+// so the result is never materialized. Pointers are valid only during the callback.
+typedef struct CCoverageVisitor {
+    void* _Nullable context;
+    // called before segments of the file. name is not null terminated
+    void (* _Nonnull begin_file)(void* _Nullable context, const char* _Nonnull name, size_t name_length);
+    // segments of the current file in order, in batches of up to COVERAGE_VISITOR_BATCH_SIZE
+    void (* _Nonnull segments)(void* _Nullable context, const CCoverageSegment* _Nonnull segments, size_t count);
+    // called after all segments of the file
+    void (* _Nonnull end_file)(void* _Nullable context);
+} CCoverageVisitor;
+
+// coverage relative to the baseline profile of the parser
+typedef enum CCoverageBaselineMode {
+    // coverage of the profile as is
+    CCoverageBaselineModeNone = 0,
+    // counts above the baseline counts. Regions executed as many times as in the baseline are not covered
+    CCoverageBaselineModeSubtract = 1,
+    // only regions which aren't covered in the baseline
+    CCoverageBaselineModeNewRegions = 2
+} CCoverageBaselineMode;
+
+// counters of the parsing phases. Values are added to the struct, so one struct can sum many calls.
+// times are in nanoseconds of the monotonic clock
+typedef struct CCoverageStats {
+    // binaries load and file table indexing on parser creation
+    uint64_t load_ns;
+    // decode of the mapping regions of binaries executed for the first time
+    uint64_t decode_ns;
+    // reading of the profile counters
+    uint64_t read_profile_ns;
+    // evaluation of the mapping regions with counters. includes decode_ns
+    uint64_t mapping_ns;
+    // building of the file segments and regions
+    uint64_t segments_ns;
+    // conversion of the regions to the result structures
+    uint64_t convert_ns;
+    // functions with counters in the profile
+    uint64_t records_read;
+    // profile functions found in the mappings with the same structural hash
+    uint64_t functions_matched;
+    // profile functions found in the mappings by name only. Their coverage is ignored
+    uint64_t functions_mismatched;
+    uint64_t files_emitted;
+    uint64_t segments_emitted;
+    // profile counters, evaluated regions and the result memory block
+    uint64_t bytes_allocated;
+} CCoverageStats;
+
+// batch parsing callback. Called for each profraw file with its index in the batch
+typedef void (* CCoverageFilesCallback)(void* _Nullable context, size_t index, CCoverageFilesResult result);
+
 struct CCoverageParser {
     // parse profraw file and return file stats
     CCoverageFilesResult (* _Nonnull covered_files)(const struct CCoverageParser* _Nonnull self,
                                                     const char* _Nonnull profraw_file);
+    // parse profile in memory: raw profile or counters snapshot from the collector
+    CCoverageFilesResult (* _Nonnull covered_files_in_buffer)(const struct CCoverageParser* _Nonnull self,
+                                                              const void* _Nonnull data, size_t size);
+    // parse profraw files in parallel on the parser threads.
+    // callback is called from the parser threads as soon as a file is parsed.
+    // returns when all files are parsed
+    void (* _Nonnull covered_files_batch)(const struct CCoverageParser* _Nonnull self,
+                                          const char* _Nonnull const* _Nonnull profraw_files, size_t count,
+                                          void* _Nullable context, CCoverageFilesCallback _Nonnull callback);
+    // free files returned by covered_files, covered_files_batch or accumulator
+    void (* _Nonnull free_result)(const struct CCoverageParser* _Nonnull self, CCoverageFiles files);
+    // create empty accumulator. It should be destroyed before the parser
+    struct CCoverageAccumulator* _Nonnull (* _Nonnull create_accumulator)(const struct CCoverageParser* _Nonnull self);
     // delete coverage processor object
     void (* _Nonnull destroy)(struct CCoverageParser* _Nonnull self);
+    // parse profraw file and stream files to the visitor. returns error string or NULL
+    const char* _Nullable (* _Nonnull visit_covered_files)(const struct CCoverageParser* _Nonnull self,
+                                                           const char* _Nonnull profraw_file,
+                                                           const CCoverageVisitor* _Nonnull visitor);
+    // parse profile in memory and stream files to the visitor. returns error string or NULL
+    const char* _Nullable (* _Nonnull visit_covered_files_in_buffer)(const struct CCoverageParser* _Nonnull self,
+                                                                     const void* _Nonnull data, size_t size,
+                                                                     const CCoverageVisitor* _Nonnull visitor);
+    // parse profraw file and return line coverage of the files. Counts are optional
+    CCoverageLinesResult (* _Nonnull covered_lines)(const struct CCoverageParser* _Nonnull self,
+                                                    const char* _Nonnull profraw_file, bool with_counts);
+    // parse profile in memory and return line coverage of the files
+    CCoverageLinesResult (* _Nonnull covered_lines_in_buffer)(const struct CCoverageParser* _Nonnull self,
+                                                              const void* _Nonnull data, size_t size,
+                                                              bool with_counts);
+    // free lines returned by covered_lines
+    void (* _Nonnull free_lines_result)(const struct CCoverageParser* _Nonnull self, CCoverageLines lines);
+    // merge results of many profiles into one on the parser threads. Files are merged in parallel.
+    // Regions with the same location are summed, other regions are kept, so they may overlap.
+    // Results are not freed. Merged files should be freed with free_result
+    CCoverageFiles (* _Nonnull merge_results)(const struct CCoverageParser* _Nonnull self,
+                                              const CCoverageFiles* _Nonnull results, size_t count);
+    // parse profraw file and return executed functions and their files.
+    // Mappings are not decoded and regions are not built, so it's much faster than covered_files
+    CCoverageTouchedResult (* _Nonnull touched_files)(const struct CCoverageParser* _Nonnull self,
+                                                      const char* _Nonnull profraw_file);
+    // parse profile in memory and return executed functions and their files
+    CCoverageTouchedResult (* _Nonnull touched_files_in_buffer)(const struct CCoverageParser* _Nonnull self,
+                                                                const void* _Nonnull data, size_t size);
+    // free result of touched_files
+    void (* _Nonnull free_touched_result)(const struct CCoverageParser* _Nonnull self, CCoverageTouched touched);
+    // read baseline profile from profraw file. Replaces the previous baseline. returns error string or NULL
+    const char* _Nullable (* _Nonnull set_baseline)(const struct CCoverageParser* _Nonnull self,
+                                                    const char* _Nonnull profraw_file);
+    // read baseline profile from memory. Empty profile resets the baseline. returns error string or NULL
+    const char* _Nullable (* _Nonnull set_baseline_in_buffer)(const struct CCoverageParser* _Nonnull self,
+                                                              const void* _Nullable data, size_t size);
+    // parse profraw file and return coverage relative to the baseline. Coverage is full if there is no baseline
+    CCoverageFilesResult (* _Nonnull covered_files_relative)(const struct CCoverageParser* _Nonnull self,
+                                                             const char* _Nonnull profraw_file,
+                                                             CCoverageBaselineMode mode);
+    // parse profile in memory and return coverage relative to the baseline
+    CCoverageFilesResult (* _Nonnull covered_files_in_buffer_relative)(const struct CCoverageParser* _Nonnull self,
+                                                                       const void* _Nonnull data, size_t size,
+                                                                       CCoverageBaselineMode mode);
+    // parse profraw file and return covered files. phase counters are added to the stats
+    CCoverageFilesResult (* _Nonnull covered_files_with_stats)(const struct CCoverageParser* _Nonnull self,
+                                                               const char* _Nonnull profraw_file,
+                                                               CCoverageStats* _Nonnull stats);
+    // parse profile in memory and return covered files. phase counters are added to the stats
+    CCoverageFilesResult (* _Nonnull covered_files_in_buffer_with_stats)(const struct CCoverageParser* _Nonnull self,
+                                                                         const void* _Nonnull data, size_t size,
+                                                                         CCoverageStats* _Nonnull stats);
 };
 
 // result of constructor call
@@ -73,12 +302,33 @@ typedef struct CCoverageParserResult {
     };
 } CCoverageParserResult;
 
+// parser options. Zero initialized struct has default values
+typedef struct CCoverageParserOptions {
+    // directory for the cache of decoded coverage mappings. Cache is disabled if NULL.
+    // Binaries with the same UUID, path, size and modification time are mapped from the cache
+    const char* _Nullable cache_directory;
+    // source files filter. It's matched once with every file of the binaries.
+    // Patterns with glob characters (*, ?, [, {) match the whole path, other patterns are path prefixes
+    // matched at the path component boundary ("/src/App" matches "/src/App/a.swift", not "/src/AppTests/a.swift").
+    // File is reported if it matches any include pattern (or there are none) and no exclude pattern
+    const char* _Nonnull const* _Nullable include_files;
+    size_t include_files_count;
+    const char* _Nonnull const* _Nullable exclude_files;
+    size_t exclude_files_count;
+    // load time of the binaries is added to the stats if set
+    CCoverageStats* _Nullable stats;
+} CCoverageParserOptions;
+
 // Plugin exports type.
 struct CCoverageParserLibrary {
     // processor's llvm version
     const char* _Nonnull llvm_version;
     // Creates new proccessor instance
     CCoverageParserResult (* _Nonnull create_parser)(const char* _Nonnull const* _Nonnull binaries, uint32_t count);
+    // Creates new proccessor instance with options
+    CCoverageParserResult (* _Nonnull create_parser_with_options)(const char* _Nonnull const* _Nonnull binaries,
+                                                                  uint32_t count,
+                                                                  const CCoverageParserOptions* _Nonnull options);
 };
 
 #if defined(__cplusplus)
@@ -5,203 +5,611 @@
  */
 
 #include "CodeCoverage.hpp"
-#include "BinaryCoverageReaderRef.hpp"
+#include "ProfileCoverage.hpp"
+#include "Stats.hpp"
 
 #include <llvm17/ADT/ArrayRef.h>
-#include <llvm17/ProfileData/InstrProfReader.h>
-#include <llvm17/ProfileData/InstrProfWriter.h>
-#include <llvm17/Support/Errc.h>
-#include <llvm17/Support/FileSystem.h>
-#include <llvm17/Support/VirtualFileSystem.h>
+#include <llvm17/ADT/BitVector.h>
+#include <llvm17/ADT/DenseMap.h>
+#include <llvm17/ADT/StringMap.h>
+#include <llvm17/ProfileData/InstrProf.h>
+#include <llvm17/Support/MathExtras.h>
+
+#include <optional>
+#include <tuple>
 
 using namespace llvm;
 using namespace coverage;
 using namespace llvm17;
 
-CodeCoverage::CodeCoverage(std::vector<std::unique_ptr<llvm::coverage::BinaryCoverageReader>> readers): MappingReaders(std::move(readers)) {
+CodeCoverage::CodeCoverage(MappingTable Mappings): Mappings(std::move(Mappings)) {
 }
 
 // Constructor
-Expected<CodeCoverage> CodeCoverage::load(std::vector<StringRef> &Binaries) {
-    std::vector<std::unique_ptr<llvm::coverage::BinaryCoverageReader>> MappingReaders;
-    
-    for (const auto &Binary : Binaries) {
-        // Create memory buffer for binary file
-        auto CovMappingBufOrErr = MemoryBuffer::getFileOrSTDIN(
-            Binary, /*IsText=*/false, /*RequiresNullTerminator=*/false
-        );
-        // Handle errors
-        if (std::error_code EC = CovMappingBufOrErr.getError()) {
-            return make_error<StringError>(EC, "Can't read file");
-        }
-        // Get buffer
-        auto CovMappingBuf = CovMappingBufOrErr.get() -> getMemBufferRef();
-        SmallVector<std::unique_ptr<MemoryBuffer>, 4> Buffers;
-        // Create binary readers for this binary file
-        auto CoverageReadersOrErr = BinaryCoverageReader::create(CovMappingBuf, StringRef(), Buffers);
-        // handle errors
-        if (Error E = CoverageReadersOrErr.takeError()) {
-            return std::move(E);
-        }
-        // save binary readers to the instance
-        for (auto &Reader : CoverageReadersOrErr.get()) {
-            MappingReaders.push_back(std::move(Reader));
-        }
-    }
-    
-    return CodeCoverage(std::move(MappingReaders));
-}
-
-// Covert profraw to indexed profile data.
-// Method based on `llvm-profdata merge` source code from LLVM tools.
-Expected<std::unique_ptr<MemoryBuffer>> CodeCoverage::readProfile(StringRef ProfrawPath) const {
-    sys::fs::file_status Status;
-    // get status for file
-    sys::fs::status(ProfrawPath, Status);
-    // check file is good
-    if (!sys::fs::exists(Status)) {
-        return make_error<StringError>(make_error_code(errc::no_such_file_or_directory),
-                                       "File not found");
-    }
-    if (!llvm::sys::fs::is_regular_file(Status)) {
-        return make_error<StringError>(make_error_code(errc::is_a_directory),
-                                       "Expected file, not the directory");
-    }
-    
-    // Create reader for file
-    auto FS = llvm::vfs::getRealFileSystem();
-    auto ReaderOrErr = InstrProfReader::create(ProfrawPath, *FS);
-    if (Error E = ReaderOrErr.takeError()) {
+Expected<CodeCoverage> CodeCoverage::load(std::vector<StringRef> &Binaries,
+                                          const CCoverageParserOptions &Options)
+{
+    PhaseTimer Timer(Options.stats, &CCoverageStats::load_ns);
+    // Filter rules are compiled once and applied to the file table on load
+    std::vector<StringRef> Include(Options.include_files, Options.include_files + Options.include_files_count);
+    std::vector<StringRef> Exclude(Options.exclude_files, Options.exclude_files + Options.exclude_files_count);
+    auto FilterOrErr = FileFilter::create(Include, Exclude);
+    if (Error E = FilterOrErr.takeError()) {
+        return std::move(E);
+    }
+    
+    // Decode coverage mapping of all binaries once. Table is immutable after that
+    StringRef CacheDirectory = Options.cache_directory ? StringRef(Options.cache_directory) : StringRef();
+    auto MappingsOrErr = MappingTable::load(Binaries, CacheDirectory, FilterOrErr.get());
+    if (Error E = MappingsOrErr.takeError()) {
+        return std::move(E);
+    }
+    return CodeCoverage(std::move(MappingsOrErr.get()));
+}
+
+CCoverageSegment CodeCoverage::segment(const CoverageSegment &Segment) {
+    return CCoverageSegment({
+        .Line = Segment.Line,
+        .Column = Segment.Col,
+        .Count = Segment.Count,
+        .HasCount = Segment.HasCount,
+        .IsRegionEntry = Segment.IsRegionEntry,
+        .IsGapRegion = Segment.IsGapRegion
+    });
+}
+
+void CodeCoverage::Regions::add(uint32_t StartLine, uint32_t StartColumn,
+                                uint32_t EndLine, uint32_t EndColumn, uint64_t Count)
+{
+    StartLines.push_back(StartLine);
+    StartColumns.push_back(StartColumn);
+    EndLines.push_back(EndLine);
+    EndColumns.push_back(EndColumn);
+    Counts.push_back(Count);
+}
+
+// Build covered regions of the file from its segments.
+// Segment starts a region when count becomes non zero, ends it on zero and splits it on count change.
+// Segments are sorted, so regions are sorted by start position too.
+void CodeCoverage::processRegions(ArrayRef<CoverageSegment> CoverageForFile, Regions &Result) {
+    uint32_t StartLine = 0;
+    uint32_t StartColumn = 0;
+    uint64_t Count = 0;
+    for (const auto &Segment : CoverageForFile) {
+        if (Count == 0 && Segment.Count != 0) {
+            // start Boundary
+            StartLine = Segment.Line;
+            StartColumn = Segment.Col;
+            Count = Segment.Count;
+        } else if (Count != 0 && Segment.Count == 0) {
+            // end Segment
+            Result.add(StartLine, StartColumn, Segment.Line, Segment.Col, Count);
+            StartLine = StartColumn = 0;
+            Count = 0;
+        } else if (Count != 0 && Segment.Count != Count) {
+            // change Segment. New region starts right after the end of this one
+            if (Segment.Col > 0) {
+                Result.add(StartLine, StartColumn, Segment.Line, Segment.Col - 1, Count);
+            } else {
+                Result.add(StartLine, StartColumn, Segment.Line - 1, Segment.Col, Count);
+            }
+            StartLine = Segment.Line;
+            StartColumn = Segment.Col;
+            Count = Segment.Count;
+        }
+    }
+}
+
+// Calculate coverage for profraw file
+// Based on `llvm-cov show` source code from LLVM tools.
+// Reads profile counters from the file or memory and adds their counters to the stats
+template <typename Source>
+static Expected<ProfileCounters> readProfile(Source Profile, CCoverageStats *Stats) {
+    auto ProfileOrErr = [&] {
+        PhaseTimer Timer(Stats, &CCoverageStats::read_profile_ns);
+        return ProfileCounters::read(Profile);
+    }();
+    if (ProfileOrErr && Stats) {
+        Stats->records_read += ProfileOrErr->size();
+        Stats->bytes_allocated += ProfileOrErr->allocatedSize();
+    }
+    return ProfileOrErr;
+}
+
+Expected<CCoverageFiles> CodeCoverage::coverage(StringRef ProfrawPath, CCoverageStats *Stats) const {
+    // Read counters of the executed functions from profraw.
+    // Raw profile is used directly, without conversion to the indexed profile.
+    auto ProfileOrErr = readProfile(ProfrawPath, Stats);
+    if (Error E = ProfileOrErr.takeError()) {
         return std::move(E);
     }
+    return coverageFiles(ProfileOrErr.get(), nullptr, CCoverageBaselineModeNone, Stats);
+}
+
+// Calculate coverage for profile in memory. Raw profile or counters snapshot
+Expected<CCoverageFiles> CodeCoverage::coverage(MemoryBufferRef Profile, CCoverageStats *Stats) const {
+    auto ProfileOrErr = readProfile(Profile, Stats);
+    if (Error E = ProfileOrErr.takeError()) {
+        return std::move(E);
+    }
+    return coverageFiles(ProfileOrErr.get(), nullptr, CCoverageBaselineModeNone, Stats);
+}
+
+// Calculate coverage for counters of one or many profiles
+Expected<CCoverageFiles> CodeCoverage::coverage(const ProfileCounters &Profile) const {
+    return coverageFiles(Profile, nullptr, CCoverageBaselineModeNone);
+}
+
+// Calculate coverage relative to the baseline profile.
+// Regions are evaluated with both profiles and compared, so segments are built only once
+Expected<CCoverageFiles> CodeCoverage::coverage(const ProfileCounters &Profile, const ProfileCounters &Baseline,
+                                                CCoverageBaselineMode Mode) const
+{
+    return coverageFiles(Profile, &Baseline, Mode);
+}
 
-    auto Reader = std::move(ReaderOrErr.get());
+// Regions are compared with the baseline in the provided mode if it's set
+Expected<CCoverageFiles> CodeCoverage::coverageFiles(const ProfileCounters &Profile,
+                                                     const ProfileCounters *Baseline,
+                                                     CCoverageBaselineMode Mode,
+                                                     CCoverageStats *Stats) const
+{
+    // Evaluate mapping records with profile counters. Binaries are decoded on first use
+    auto CoverageOrErr = [&] {
+        PhaseTimer Timer(Stats, &CCoverageStats::mapping_ns);
+        return ProfileCoverage::load(Mappings, Profile, Baseline, Mode, Stats);
+    }();
+    if (Error E = CoverageOrErr.takeError()) {
+        return std::move(E);
+    }
+    auto &Coverage = CoverageOrErr.get();
+    if (Stats) {
+        Stats->bytes_allocated += Coverage.allocatedSize();
+    }
     
-    // Create writer
-    InstrProfWriter Writer(/*sparse*/ true);
+    auto Files = Coverage.files();
+    if (Files.size() == 0) {
+        return CCoverageFiles({ nullptr, 0, 0 });
+    }
     
-    // Set writer type
-    if (Error E = Writer.mergeProfileKind(Reader->getProfileKind())) {
-        return std::move(E);
+    std::vector<StringRef> Names(Files.size());
+    std::vector<Regions> FileRegions(Files.size());
+    {
+        PhaseTimer Timer(Stats, &CCoverageStats::segments_ns);
+        for (size_t Current = 0; Current < Files.size(); Current++) {
+            Names[Current] = Mappings.files()[Files[Current]];
+            auto Segments = Coverage.getSegmentsForFile(Current);
+            processRegions(Segments, FileRegions[Current]);
+            if (Stats) {
+                Stats->segments_emitted += Segments.size();
+            }
+        }
     }
+    PhaseTimer Timer(Stats, &CCoverageStats::convert_ns);
+    auto Result = files(Names, FileRegions);
+    if (Stats) {
+        Stats->files_emitted += Result.files_count;
+        Stats->bytes_allocated += Result.size;
+    }
+    return Result;
+}
+
+// Convert regions of the files to the C structures so they can be sent to the Swift.
+// Everything is in one block: files table, counts, start lines, start columns,
+// end lines and end columns of all regions, file names.
+CCoverageFiles CodeCoverage::files(ArrayRef<StringRef> Names, ArrayRef<Regions> FileRegions) {
+    if (Names.empty()) {
+        return CCoverageFiles({ nullptr, 0, 0 });
+    }
+    
+    size_t Count = 0;
+    size_t NamesSize = 0;
+    for (size_t Current = 0; Current < Names.size(); Current++) {
+        Count += FileRegions[Current].size();
+        NamesSize += Names[Current].size() + 1;
+    }
+    
+    static_assert(sizeof(CCoverageFile) % alignof(uint64_t) == 0,
+                  "Counts should be aligned after the files table");
+    size_t FilesSize = sizeof(CCoverageFile) * Names.size();
+    size_t ColumnsSize = (sizeof(uint64_t) + 4 * sizeof(uint32_t)) * Count;
+    size_t Size = FilesSize + ColumnsSize + NamesSize;
+    char* Block = new char[Size];
     
-    // Write records from the Reader to the Writer
-    std::optional<Error> WriteError;
-    for (auto &I : *Reader) {
-        Writer.addRecord(std::move(I), [&](Error E) {
-            WriteError = std::move(E);
-        });
-        // Handle write error
-        if (WriteError.has_value()) {
-            return std::move(*WriteError);
+    CCoverageFile *CoverageFiles = reinterpret_cast<CCoverageFile*>(Block);
+    uint64_t *Counts = reinterpret_cast<uint64_t*>(Block + FilesSize);
+    uint32_t *StartLines = reinterpret_cast<uint32_t*>(Counts + Count);
+    uint32_t *StartColumns = StartLines + Count;
+    uint32_t *EndLines = StartColumns + Count;
+    uint32_t *EndColumns = EndLines + Count;
+    char *NamesBlock = Block + FilesSize + ColumnsSize;
+    for (size_t Current = 0; Current < Names.size(); Current++) {
+        StringRef Name = Names[Current];
+        memcpy(NamesBlock, Name.data(), Name.size());
+        NamesBlock[Name.size()] = '\0';
+        
+        const Regions &FileRegion = FileRegions[Current];
+        CCoverageFile &File = CoverageFiles[Current];
+        File.name = NamesBlock;
+        File.regions_count = FileRegion.size();
+        if (File.regions_count > 0) {
+            File.counts = Counts;
+            File.start_lines = StartLines;
+            File.start_columns = StartColumns;
+            File.end_lines = EndLines;
+            File.end_columns = EndColumns;
+            Counts = llvm::copy(FileRegion.Counts, Counts);
+            StartLines = llvm::copy(FileRegion.StartLines, StartLines);
+            StartColumns = llvm::copy(FileRegion.StartColumns, StartColumns);
+            EndLines = llvm::copy(FileRegion.EndLines, EndLines);
+            EndColumns = llvm::copy(FileRegion.EndColumns, EndColumns);
+        } else {
+            File.start_lines = File.start_columns = File.end_lines = File.end_columns = nullptr;
+            File.counts = nullptr;
         }
+        NamesBlock += Name.size() + 1;
     }
+    return CCoverageFiles({ CoverageFiles, Names.size(), Size });
+}
+
+// K-way merge of the sorted regions of one file from many results.
+// Regions with the same location are summed with saturation, so the result is sorted too.
+// Regions of different results aren't split, so they may overlap in the result.
+void CodeCoverage::mergeFile(ArrayRef<const CCoverageFile*> Files, Regions &Result) {
+    using Location = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>;
+    // Next region of one file
+    struct Cursor {
+        Location Start;
+        uint32_t File;
+        size_t Index;
+    };
+    auto location = [&](uint32_t File, size_t Index) {
+        const CCoverageFile &F = *Files[File];
+        return Location(F.start_lines[Index], F.start_columns[Index], F.end_lines[Index], F.end_columns[Index]);
+    };
+    auto Greater = [](const Cursor &L, const Cursor &R) { return L.Start > R.Start; };
     
-    // New feature in LLVM17. Save temporal profile
-    if (Reader->hasTemporalProfile()) {
-        auto &Traces = Reader->getTemporalProfTraces();
-        if (!Traces.empty()) {
-            Writer.addTemporalProfileTraces(Traces, Reader->getTemporalProfTraceStreamSize());
+    std::vector<Cursor> Heap;
+    Heap.reserve(Files.size());
+    for (uint32_t File = 0; File < Files.size(); File++) {
+        if (Files[File]->regions_count > 0) {
+            Heap.push_back({ location(File, 0), File, 0 });
         }
     }
+    std::make_heap(Heap.begin(), Heap.end(), Greater);
     
-    // Handle reader errors. Could happen in the iteration
-    if (Reader->hasError()) {
-        if (Error E = Reader->getError()) {
-            return std::move(E);
+    std::optional<Location> Last;
+    while (!Heap.empty()) {
+        std::pop_heap(Heap.begin(), Heap.end(), Greater);
+        Cursor &Top = Heap.back();
+        uint64_t Count = Files[Top.File]->counts[Top.Index];
+        if (Last == Top.Start) {
+            Result.Counts.back() = SaturatingAdd(Result.Counts.back(), Count);
+        } else {
+            auto [StartLine, StartColumn, EndLine, EndColumn] = Top.Start;
+            Result.add(StartLine, StartColumn, EndLine, EndColumn, Count);
+            Last = Top.Start;
+        }
+        if (++Top.Index < Files[Top.File]->regions_count) {
+            Top.Start = location(Top.File, Top.Index);
+            std::push_heap(Heap.begin(), Heap.end(), Greater);
+        } else {
+            Heap.pop_back();
+        }
+    }
+}
+
+// Merge results of many profiles. Files are independent, so they are the units of the parallel work.
+// Regions of every file are sorted in all results, so each file is a k-way merge of the sorted streams
+CCoverageFiles CodeCoverage::merge(ArrayRef<CCoverageFiles> Results, ThreadPool &Pool) {
+    // Group files of all results by name
+    StringMap<SmallVector<const CCoverageFile*, 4>> Groups;
+    for (const auto &Result : Results) {
+        for (size_t Current = 0; Current < Result.files_count; Current++) {
+            Groups[Result.files[Current].name].push_back(&Result.files[Current]);
         }
     }
+    std::vector<StringRef> Names;
+    Names.reserve(Groups.size());
+    for (const auto &Group : Groups) {
+        Names.push_back(Group.getKey());
+    }
+    llvm::sort(Names);
     
-    // Apple LLVM 17 has VTable symbols but by default flag is false and can be ignored
-    // New feature in LLVM17. Save binary ids
-    std::vector<llvm::object::BuildID> BinaryIds;
-    if (Error E = Reader->readBinaryIds(BinaryIds)) {
-        return std::move(E);
+    // Map is only read by the pool threads
+    std::vector<Regions> FileRegions(Names.size());
+    Pool.parallelFor(Names.size(), [&](size_t Current) {
+        mergeFile(Groups.find(Names[Current])->second, FileRegions[Current]);
+    });
+    return files(Names, FileRegions);
+}
+
+// Stream coverage of the profraw file to the visitor
+Error CodeCoverage::visit(StringRef ProfrawPath, const CCoverageVisitor &Visitor) const {
+    auto ProfileOrErr = ProfileCounters::read(ProfrawPath);
+    if (Error E = ProfileOrErr.takeError()) {
+        return E;
     }
-    Writer.addBinaryIds(BinaryIds);
+    return visit(ProfileOrErr.get(), Visitor);
+}
 
-    // Write indexed data to the buffer and return
-    return Writer.writeBuffer();
+// Stream coverage of the profile in memory to the visitor
+Error CodeCoverage::visit(MemoryBufferRef Profile, const CCoverageVisitor &Visitor) const {
+    auto ProfileOrErr = ProfileCounters::read(Profile);
+    if (Error E = ProfileOrErr.takeError()) {
+        return E;
+    }
+    return visit(ProfileOrErr.get(), Visitor);
 }
 
-// Convert file coverage to the C structure so it can be sent to the Swift
-CCoverageFile CodeCoverage::processFile(StringRef Name, CoverageMapping &Coverage) const {
-    auto CoverageForFile = Coverage.getCoverageForFile(Name);
+// Stream coverage to the visitor file by file. Only segments of the current file are in memory,
+// they are sent in fixed size batches.
+Error CodeCoverage::visit(const ProfileCounters &Profile, const CCoverageVisitor &Visitor) const {
+    auto CoverageOrErr = ProfileCoverage::load(Mappings, Profile);
+    if (Error E = CoverageOrErr.takeError()) {
+        return E;
+    }
+    auto &Coverage = CoverageOrErr.get();
     
-    char* NameStr = new char[Name.size()+1];
-    memcpy(NameStr, Name.data(), Name.size());
-    NameStr[Name.size()] = '\0';
+    CCoverageSegment Batch[COVERAGE_VISITOR_BATCH_SIZE];
+    auto Files = Coverage.files();
+    for (size_t Current = 0; Current < Files.size(); Current++) {
+        StringRef Name = Mappings.files()[Files[Current]];
+        Visitor.begin_file(Visitor.context, Name.data(), Name.size());
+        size_t Count = 0;
+        for (const auto &Segment : Coverage.getSegmentsForFile(Current)) {
+            Batch[Count++] = segment(Segment);
+            if (Count == COVERAGE_VISITOR_BATCH_SIZE) {
+                Visitor.segments(Visitor.context, Batch, Count);
+                Count = 0;
+            }
+        }
+        if (Count > 0) {
+            Visitor.segments(Visitor.context, Batch, Count);
+        }
+        Visitor.end_file(Visitor.context);
+    }
+    return Error::success();
+}
+
+// Line coverage of the file from its segments. Based on LineCoverageIterator.
+// Bitsets and counts should be zeroed
+void CodeCoverage::processLines(ArrayRef<CoverageSegment> CoverageForFile,
+                                uint64_t *Coverable, uint64_t *Covered, uint64_t *Counts)
+{
+    SmallVector<const CoverageSegment*, 8> LineSegments;
+    const CoverageSegment *WrappedSegment = nullptr;
+    size_t Next = 0;
+    for (unsigned Line = CoverageForFile.front().Line; Next < CoverageForFile.size(); Line++) {
+        // Last segment of the previous lines with segments continues on this line
+        if (!LineSegments.empty()) {
+            WrappedSegment = LineSegments.back();
+        }
+        LineSegments.clear();
+        while (Next < CoverageForFile.size() && CoverageForFile[Next].Line == Line) {
+            LineSegments.push_back(&CoverageForFile[Next++]);
+        }
+        LineCoverageStats Stats(LineSegments, WrappedSegment, Line);
+        if (!Stats.isMapped()) {
+            continue;
+        }
+        uint32_t Index = Line - 1;
+        uint64_t Bit = uint64_t(1) << (Index % 64);
+        Coverable[Index / 64] |= Bit;
+        if (Stats.getExecutionCount() > 0) {
+            Covered[Index / 64] |= Bit;
+        }
+        if (Counts) {
+            Counts[Index] = Stats.getExecutionCount();
+        }
+    }
+}
+
+// Calculate line coverage for profraw file
+Expected<CCoverageLines> CodeCoverage::lines(StringRef ProfrawPath, bool WithCounts) const {
+    auto ProfileOrErr = ProfileCounters::read(ProfrawPath);
+    if (Error E = ProfileOrErr.takeError()) {
+        return std::move(E);
+    }
+    return lines(ProfileOrErr.get(), WithCounts);
+}
+
+// Calculate line coverage for profile in memory. Raw profile or counters snapshot
+Expected<CCoverageLines> CodeCoverage::lines(MemoryBufferRef Profile, bool WithCounts) const {
+    auto ProfileOrErr = ProfileCounters::read(Profile);
+    if (Error E = ProfileOrErr.takeError()) {
+        return std::move(E);
+    }
+    return lines(ProfileOrErr.get(), WithCounts);
+}
+
+// Calculate line coverage for counters of one or many profiles.
+// Result has packed bitsets, so it's much smaller than segments and can be merged by words
+Expected<CCoverageLines> CodeCoverage::lines(const ProfileCounters &Profile, bool WithCounts) const {
+    auto CoverageOrErr = ProfileCoverage::load(Mappings, Profile);
+    if (Error E = CoverageOrErr.takeError()) {
+        return std::move(E);
+    }
+    auto &Coverage = CoverageOrErr.get();
     
-    auto Count = std::distance(CoverageForFile.begin(), CoverageForFile.end());
-    if (Count == 0) {
-        return CCoverageFile({ NameStr, nullptr, 0 });
+    auto Files = Coverage.files();
+    if (Files.size() == 0) {
+        return CCoverageLines({ nullptr, 0, 0 });
     }
     
-    CCoverageSegment* Segments = new CCoverageSegment[Count];
-    size_t CurrentSegment = 0;
-    for (const auto &Segment: CoverageForFile) {
-        Segments[CurrentSegment] = {
-            .Line = Segment.Line,
-            .Column = Segment.Col,
-            .Count = Segment.Count,
-            .HasCount = Segment.HasCount,
-            .IsRegionEntry = Segment.IsRegionEntry,
-            .IsGapRegion = Segment.IsGapRegion
-        };
-        CurrentSegment++;
+    // Build segments of all files first, so the size of the result is known
+    std::vector<std::vector<CoverageSegment>> Segments(Files.size());
+    size_t WordsSize = 0;
+    size_t NamesSize = 0;
+    for (size_t Current = 0; Current < Files.size(); Current++) {
+        Segments[Current] = Coverage.getSegmentsForFile(Current);
+        size_t Lines = Segments[Current].empty() ? 0 : Segments[Current].back().Line;
+        WordsSize += 2 * ((Lines + 63) / 64) + (WithCounts ? Lines : 0);
+        NamesSize += Mappings.files()[Files[Current]].size() + 1;
     }
     
-    return CCoverageFile({ NameStr, Segments, size_t(Count) });
+    // Everything is in one zeroed block: files table, bitsets and counts of all files, file names.
+    static_assert(sizeof(CCoverageFileLines) % alignof(uint64_t) == 0,
+                  "Bitsets should be aligned after the files table");
+    size_t FilesSize = sizeof(CCoverageFileLines) * Files.size();
+    size_t Size = FilesSize + WordsSize * sizeof(uint64_t) + NamesSize;
+    char* Block = new char[Size]();
+    
+    CCoverageFileLines *CoverageFiles = reinterpret_cast<CCoverageFileLines*>(Block);
+    uint64_t *Words = reinterpret_cast<uint64_t*>(Block + FilesSize);
+    char *Names = Block + FilesSize + WordsSize * sizeof(uint64_t);
+    for (size_t Current = 0; Current < Files.size(); Current++) {
+        StringRef Name = Mappings.files()[Files[Current]];
+        memcpy(Names, Name.data(), Name.size());
+        
+        uint32_t Lines = Segments[Current].empty() ? 0 : Segments[Current].back().Line;
+        size_t BitsetSize = (Lines + 63) / 64;
+        CCoverageFileLines &File = CoverageFiles[Current];
+        File.name = Names;
+        File.lines_count = Lines;
+        File.coverable = Words;
+        File.covered = Words + BitsetSize;
+        File.counts = WithCounts ? Words + 2 * BitsetSize : nullptr;
+        if (Lines > 0) {
+            processLines(Segments[Current], Words, Words + BitsetSize, WithCounts ? Words + 2 * BitsetSize : nullptr);
+        }
+        Names += Name.size() + 1;
+        Words += 2 * BitsetSize + (WithCounts ? Lines : 0);
+    }
+    return CCoverageLines({ CoverageFiles, Files.size(), Size });
 }
 
-// Calculate coverage for profraw file
-// Based on `llvm-cov show` source code from LLVM tools.
-Expected<CCoverageFiles> CodeCoverage::coverage(StringRef ProfrawPath) const {
-    // Read profraw and get profdata buffer.
-    auto ProfileBufferOrErr = readProfile(ProfrawPath);
-    if (Error E = ProfileBufferOrErr.takeError()) {
+// Executed functions and files of the profraw file
+Expected<CCoverageTouched> CodeCoverage::touched(StringRef ProfrawPath) const {
+    auto ProfileOrErr = ProfileCounters::read(ProfrawPath);
+    if (Error E = ProfileOrErr.takeError()) {
         return std::move(E);
     }
-    auto ProfileBuffer = std::move(ProfileBufferOrErr.get());
-    
-    // Create indexed reader for profdata buffer
-    auto ProfileReaderOrErr = IndexedInstrProfReader::create(std::move(ProfileBuffer));
-    if (Error E = ProfileReaderOrErr.takeError()) {
+    return touched(ProfileOrErr.get());
+}
+
+// Executed functions and files of the profile in memory. Raw profile or counters snapshot
+Expected<CCoverageTouched> CodeCoverage::touched(MemoryBufferRef Profile) const {
+    auto ProfileOrErr = ProfileCounters::read(Profile);
+    if (Error E = ProfileOrErr.takeError()) {
         return std::move(E);
     }
-    auto ProfileReader = std::move(ProfileReaderOrErr.get());
+    return touched(ProfileOrErr.get());
+}
+
+// Executed functions with their files. Profile keeps only functions with non zero counters
+// and file lists are read on load from the record headers, so regions are never decoded nor evaluated.
+// Same function can have records in many binaries and translation units (linkonce, inlined functions).
+// Records are merged by the name hash and the function hash, their file lists are united.
+Expected<CCoverageTouched> CodeCoverage::touched(const ProfileCounters &Profile) const {
+    auto Matched = ProfileCoverage::matchedFunctions(Mappings, Profile);
+    auto Functions = Mappings.functions();
     
-    // We are using methods from our patch so we can reuse readers.
-    // We will create Ref classes for the real readers so we can iterate
-    // in the different threads at the same time.
-    std::vector<std::unique_ptr<CoverageMappingReader>> Readers;
-    Readers.reserve(MappingReaders.size());
+    // Executed function with the included files of all its records
+    struct TouchedFunction {
+        uint32_t Index;
+        StringRef Name;
+        SmallVector<uint32_t, 2> Files;
+    };
     
-    for (auto &Reader: MappingReaders) {
-        Readers.push_back(
-            std::unique_ptr<CoverageMappingReader>(
-                new BinaryCoverageReaderRef(Reader.get())
-            )
-        );
+    // Touched files by the table index and executed functions with included files
+    BitVector TouchedFiles(Mappings.files().size());
+    std::vector<TouchedFunction> Executed;
+    DenseMap<std::pair<uint64_t, uint64_t>, uint32_t> ExecutedIndex;
+    size_t FileIndexesCount = 0;
+    size_t NamesSize = 0;
+    for (uint32_t Index : Matched) {
+        const auto &Function = Functions[Index];
+        auto FunctionFiles = Mappings.files(Function);
+        if (llvm::none_of(FunctionFiles, [&](uint32_t File) { return Mappings.isIncluded(File); })) {
+            continue;
+        }
+        auto [Found, Inserted] = ExecutedIndex.try_emplace({Function.NameHash, Function.Hash},
+                                                           uint32_t(Executed.size()));
+        if (Inserted) {
+            StringRef Name = getFuncNameWithoutPrefix(Function.Name, Mappings.files()[FunctionFiles[0]]);
+            Executed.push_back({Index, Name, {}});
+            NamesSize += Name.size() + 1;
+        }
+        auto &Touched = Executed[Found->second];
+        for (uint32_t File : FunctionFiles) {
+            TouchedFiles.set(File);
+            if (Mappings.isIncluded(File)) {
+                Touched.Files.push_back(File);
+            }
+        }
+    }
+    if (Executed.empty()) {
+        return CCoverageTouched({ nullptr, 0, nullptr, 0, 0 });
+    }
+    for (auto &Touched : Executed) {
+        llvm::sort(Touched.Files);
+        Touched.Files.erase(std::unique(Touched.Files.begin(), Touched.Files.end()), Touched.Files.end());
+        FileIndexesCount += Touched.Files.size();
     }
     
-    // create coverage mapping from resetted readers and profile
-    auto CoverageOrErr = CoverageMapping::load(ArrayRef(Readers), *ProfileReader);
-    
-    // handle errors
-    if (Error E = CoverageOrErr.takeError()) {
-        return std::move(E);
+    // Files are reported by the position in the result. Table files are sorted, so positions are too
+    std::vector<uint32_t> Positions(Mappings.files().size());
+    size_t FilesCount = 0;
+    for (unsigned File : TouchedFiles.set_bits()) {
+        if (Mappings.isIncluded(File)) {
+            Positions[File] = uint32_t(FilesCount++);
+            NamesSize += Mappings.files()[File].size() + 1;
+        }
     }
-    auto Coverage = std::move(CoverageOrErr.get());
     
-    // Convert report to the C structures
-    auto Files = Coverage->getUniqueSourceFiles();
-    if (Files.size() == 0) {
-        return CCoverageFiles({ nullptr, 0 });
+    // Everything is in one block: file names table, functions, file indexes of the functions, names.
+    static_assert(sizeof(CCoverageFunction) % alignof(uint32_t) == 0,
+                  "File indexes should be aligned after the functions");
+    size_t FilesSize = sizeof(const char*) * FilesCount;
+    size_t FunctionsSize = sizeof(CCoverageFunction) * Executed.size();
+    size_t IndexesSize = sizeof(uint32_t) * FileIndexesCount;
+    size_t Size = FilesSize + FunctionsSize + IndexesSize + NamesSize;
+    char* Block = new char[Size];
+    
+    const char **Files = reinterpret_cast<const char**>(Block);
+    CCoverageFunction *CoverageFunctions = reinterpret_cast<CCoverageFunction*>(Block + FilesSize);
+    uint32_t *Indexes = reinterpret_cast<uint32_t*>(Block + FilesSize + FunctionsSize);
+    char *Names = Block + FilesSize + FunctionsSize + IndexesSize;
+    auto copyName = [&](StringRef Name) {
+        char *Copy = Names;
+        memcpy(Copy, Name.data(), Name.size());
+        Copy[Name.size()] = '\0';
+        Names += Name.size() + 1;
+        return Copy;
+    };
+    
+    size_t Position = 0;
+    for (unsigned File : TouchedFiles.set_bits()) {
+        if (Mappings.isIncluded(File)) {
+            Files[Position++] = copyName(Mappings.files()[File]);
+        }
     }
-    CCoverageFile *CoverageFiles = new CCoverageFile[Files.size()];
-    for (size_t Current = 0; Current < Files.size(); Current++) {
-        CoverageFiles[Current] = processFile(Files[Current], *Coverage);
+    for (size_t Current = 0; Current < Executed.size(); Current++) {
+        const auto &Touched = Executed[Current];
+        CCoverageFunction &Result = CoverageFunctions[Current];
+        Result.name = copyName(Touched.Name);
+        Result.hash = Functions[Touched.Index].Hash;
+        Result.files = Indexes;
+        for (uint32_t File : Touched.Files) {
+            *Indexes++ = Positions[File];
+        }
+        Result.files_count = Touched.Files.size();
     }
-    return CCoverageFiles({ CoverageFiles, Files.size() });
+    return CCoverageTouched({ Files, FilesCount, CoverageFunctions, Executed.size(), Size });
+}
+
+// Free result of the coverage() call
+void CodeCoverage::free(CCoverageFiles Files) {
+    delete[] reinterpret_cast<char*>(Files.files);
+}
+
+// Free result of the lines() call
+void CodeCoverage::free(CCoverageLines Lines) {
+    delete[] reinterpret_cast<char*>(Lines.files);
+}
+
+// Free result of the touched() call
+void CodeCoverage::free(CCoverageTouched Touched) {
+    delete[] reinterpret_cast<const char*>(Touched.files);
 }
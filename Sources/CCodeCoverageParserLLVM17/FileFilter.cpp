@@ -0,0 +1,68 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#include "FileFilter.hpp"
+
+using namespace llvm17;
+using namespace llvm;
+
+Expected<FileFilter> FileFilter::create(ArrayRef<StringRef> Include, ArrayRef<StringRef> Exclude) {
+    FileFilter Filter;
+    for (StringRef Pattern : Include) {
+        if (Error E = Filter.Include.add(Pattern)) {
+            return std::move(E);
+        }
+    }
+    for (StringRef Pattern : Exclude) {
+        if (Error E = Filter.Exclude.add(Pattern)) {
+            return std::move(E);
+        }
+    }
+    return std::move(Filter);
+}
+
+bool FileFilter::includes(StringRef Path) const {
+    if (!Include.empty() && !Include.matches(Path)) {
+        return false;
+    }
+    return !Exclude.matches(Path);
+}
+
+Error FileFilter::Rules::add(StringRef Pattern) {
+    if (Pattern.find_first_of("*?[{") == StringRef::npos) {
+        Prefixes.push_back(Pattern.str());
+        return Error::success();
+    }
+    auto GlobOrErr = GlobPattern::create(Pattern);
+    if (Error E = GlobOrErr.takeError()) {
+        return make_error<StringError>("Bad file pattern '" + Pattern + "': " + toString(std::move(E)),
+                                       inconvertibleErrorCode());
+    }
+    Globs.push_back(std::move(GlobOrErr.get()));
+    return Error::success();
+}
+
+// Prefix matches whole path components: "/src/App" matches "/src/App/main.swift", but not "/src/AppTests/main.swift"
+static bool matchesPrefix(StringRef Path, StringRef Prefix) {
+    if (!Path.startswith(Prefix)) {
+        return false;
+    }
+    return Path.size() == Prefix.size() || Prefix.endswith("/") || Path[Prefix.size()] == '/';
+}
+
+bool FileFilter::Rules::matches(StringRef Path) const {
+    for (const auto &Prefix : Prefixes) {
+        if (matchesPrefix(Path, Prefix)) {
+            return true;
+        }
+    }
+    for (const auto &Glob : Globs) {
+        if (Glob.match(Path)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,48 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#pragma once
+#include <llvm17/ADT/ArrayRef.h>
+#include <llvm17/ADT/StringRef.h>
+#include <llvm17/Support/Error.h>
+#include <llvm17/Support/GlobPattern.h>
+
+#include <string>
+#include <vector>
+
+namespace llvm17 {
+
+/// Include and exclude rules for the source file paths.
+/// Pattern with glob characters (*, ?, [, {) is matched against the whole path,
+/// other patterns are path prefixes matched at the path component boundary.
+/// File passes if it matches any include rule (or there are none) and doesn't match exclude rules.
+class FileFilter {
+public:
+    /// Filter which passes all files
+    FileFilter() = default;
+
+    static llvm::Expected<FileFilter> create(llvm::ArrayRef<llvm::StringRef> Include,
+                                             llvm::ArrayRef<llvm::StringRef> Exclude);
+
+    bool empty() const { return Include.empty() && Exclude.empty(); }
+
+    bool includes(llvm::StringRef Path) const;
+
+private:
+    struct Rules {
+        std::vector<std::string> Prefixes;
+        std::vector<llvm::GlobPattern> Globs;
+
+        bool empty() const { return Prefixes.empty() && Globs.empty(); }
+        bool matches(llvm::StringRef Path) const;
+        llvm::Error add(llvm::StringRef Pattern);
+    };
+
+    Rules Include;
+    Rules Exclude;
+};
+
+}
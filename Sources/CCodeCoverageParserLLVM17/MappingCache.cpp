@@ -0,0 +1,301 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#include "MappingCache.hpp"
+
+#include <llvm17/Config/llvm-config.h>
+#include <llvm17/Object/BuildID.h>
+#include <llvm17/Object/MachO.h>
+#include <llvm17/Object/MachOUniversal.h>
+#include <llvm17/Support/FileSystem.h>
+#include <llvm17/Support/MD5.h>
+#include <llvm17/Support/Path.h>
+#include <llvm17/Support/raw_ostream.h>
+
+#include <type_traits>
+
+using namespace llvm17;
+using namespace llvm;
+using namespace coverage;
+
+// Bump on any change of the file layout
+static constexpr uint32_t CacheVersion = 1;
+static constexpr char CacheMagic[8] = {'D', 'D', 'C', 'O', 'V', 'M', 'A', 'P'};
+static constexpr uint64_t CacheAlignment = 8;
+
+// Expressions and regions are stored as raw memory
+static_assert(std::is_trivially_copyable_v<CounterExpression>);
+static_assert(std::is_trivially_copyable_v<CounterMappingRegion>);
+static_assert(alignof(CounterExpression) <= CacheAlignment && alignof(CounterMappingRegion) <= CacheAlignment);
+
+namespace {
+
+// Array in the cache file. Offset is from the file start
+struct CacheArray {
+    uint64_t Offset;
+    uint64_t Count;
+};
+
+// Range in the strings array
+struct CacheString {
+    uint32_t Offset;
+    uint32_t Size;
+};
+
+struct CacheFunction {
+    uint64_t NameHash;
+    uint64_t Hash;
+    CacheString Name;
+    uint32_t FilesBegin;
+    uint32_t FilesSize;
+    uint32_t ExpressionsBegin;
+    uint32_t ExpressionsSize;
+    uint32_t RegionsBegin;
+    uint32_t RegionsSize;
+};
+
+struct CacheHeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t LLVMVersion;
+    // Sizes of the raw LLVM structures, so a cache of other layout is never used
+    uint32_t ExpressionSize;
+    uint32_t RegionSize;
+    CacheArray Functions;
+    CacheArray Files;
+    CacheArray FileIndexes;
+    CacheArray Expressions;
+    CacheArray Regions;
+    CacheArray Strings;
+};
+
+}
+
+MappingCache::MappingCache(StringRef Directory): Directory(Directory.str()) {
+}
+
+// UUID of the Mach-O image (of all slices for universal binaries) or build ID of the ELF file
+static void hashBuildID(MemoryBufferRef Contents, MD5 &Hash) {
+    auto BinaryOrErr = object::createBinary(Contents);
+    if (!BinaryOrErr) {
+        consumeError(BinaryOrErr.takeError());
+        return;
+    }
+    object::Binary *Binary = BinaryOrErr->get();
+    if (auto *MachO = dyn_cast<object::MachOObjectFile>(Binary)) {
+        Hash.update(MachO->getUuid());
+    } else if (auto *Universal = dyn_cast<object::MachOUniversalBinary>(Binary)) {
+        for (const auto &Slice : Universal->objects()) {
+            auto SliceOrErr = Slice.getAsObjectFile();
+            if (!SliceOrErr) {
+                consumeError(SliceOrErr.takeError());
+                continue;
+            }
+            Hash.update(SliceOrErr.get()->getUuid());
+        }
+    } else if (auto *Object = dyn_cast<object::ObjectFile>(Binary)) {
+        Hash.update(object::getBuildID(Object));
+    }
+}
+
+template <typename T>
+static void hashValue(MD5 &Hash, T Value) {
+    Hash.update(ArrayRef(reinterpret_cast<const uint8_t*>(&Value), sizeof(Value)));
+}
+
+// Path and modification time are hashed too. Not every binary has UUID
+// and ad-hoc builds can keep it between rebuilds
+std::string MappingCache::path(StringRef Binary, MemoryBufferRef Contents) const {
+    sys::fs::file_status Status;
+    if (sys::fs::status(Binary, Status)) {
+        return std::string();
+    }
+    MD5 Hash;
+    hashBuildID(Contents, Hash);
+    Hash.update(Binary);
+    hashValue(Hash, uint64_t(Status.getSize()));
+    hashValue(Hash, int64_t(Status.getLastModificationTime().time_since_epoch().count()));
+    MD5::MD5Result Result;
+    Hash.final(Result);
+
+    SmallString<256> Path(Directory);
+    sys::path::append(Path, "llvm" + Twine(LLVM_VERSION_MAJOR) + "-" + Result.digest() + ".covmap");
+    return std::string(Path);
+}
+
+template <typename T>
+static std::optional<ArrayRef<T>> cacheArray(StringRef Data, CacheArray Array) {
+    if (Array.Offset % CacheAlignment != 0 || Array.Offset > Data.size() ||
+        Array.Count > (Data.size() - Array.Offset) / sizeof(T))
+    {
+        return std::nullopt;
+    }
+    return ArrayRef(reinterpret_cast<const T*>(Data.data() + Array.Offset), size_t(Array.Count));
+}
+
+static inline bool inRange(uint64_t Begin, uint64_t Size, size_t Count) {
+    return Begin <= Count && Size <= Count - Begin;
+}
+
+std::optional<BinaryMapping> MappingCache::load(StringRef Path) {
+    // Big files are mapped, pages are loaded only when accessed
+    auto BufferOrErr = MemoryBuffer::getFile(Path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!BufferOrErr) {
+        return std::nullopt;
+    }
+    StringRef Data = BufferOrErr.get()->getBuffer();
+    // Arrays are used in place, so the memory should be aligned as the file offsets
+    if (Data.size() < sizeof(CacheHeader) || reinterpret_cast<uintptr_t>(Data.data()) % CacheAlignment != 0) {
+        return std::nullopt;
+    }
+    auto Header = reinterpret_cast<const CacheHeader*>(Data.data());
+    if (memcmp(Header->Magic, CacheMagic, sizeof(CacheMagic)) != 0 ||
+        Header->Version != CacheVersion || Header->LLVMVersion != LLVM_VERSION_MAJOR ||
+        Header->ExpressionSize != sizeof(CounterExpression) || Header->RegionSize != sizeof(CounterMappingRegion))
+    {
+        return std::nullopt;
+    }
+    auto Functions = cacheArray<CacheFunction>(Data, Header->Functions);
+    auto Files = cacheArray<CacheString>(Data, Header->Files);
+    auto FileIndexes = cacheArray<uint32_t>(Data, Header->FileIndexes);
+    auto Expressions = cacheArray<CounterExpression>(Data, Header->Expressions);
+    auto Regions = cacheArray<CounterMappingRegion>(Data, Header->Regions);
+    auto Strings = cacheArray<char>(Data, Header->Strings);
+    if (!Functions || !Files || !FileIndexes || !Expressions || !Regions || !Strings) {
+        return std::nullopt;
+    }
+
+    // Ranges are validated once here, so the table can trust them
+    BinaryMapping Mapping;
+    Mapping.Files.reserve(Files->size());
+    for (const auto &File : *Files) {
+        if (!inRange(File.Offset, File.Size, Strings->size())) {
+            return std::nullopt;
+        }
+        Mapping.Files.push_back(StringRef(Strings->data() + File.Offset, File.Size));
+    }
+    for (uint32_t Index : *FileIndexes) {
+        if (Index >= Files->size()) {
+            return std::nullopt;
+        }
+    }
+    Mapping.Functions.reserve(Functions->size());
+    for (const auto &F : *Functions) {
+        if (!inRange(F.Name.Offset, F.Name.Size, Strings->size()) ||
+            !inRange(F.FilesBegin, F.FilesSize, FileIndexes->size()) ||
+            !inRange(F.ExpressionsBegin, F.ExpressionsSize, Expressions->size()) ||
+            !inRange(F.RegionsBegin, F.RegionsSize, Regions->size()))
+        {
+            return std::nullopt;
+        }
+        Mapping.Functions.push_back({
+            .Name = StringRef(Strings->data() + F.Name.Offset, F.Name.Size),
+            .NameHash = F.NameHash,
+            .Hash = F.Hash,
+            .Binary = 0,
+            .FilesBegin = F.FilesBegin,
+            .FilesSize = F.FilesSize,
+            .ExpressionsBegin = F.ExpressionsBegin,
+            .ExpressionsSize = F.ExpressionsSize,
+            .RegionsBegin = F.RegionsBegin,
+            .RegionsSize = F.RegionsSize
+        });
+    }
+    Mapping.FileIndexes = *FileIndexes;
+    Mapping.Expressions = *Expressions;
+    Mapping.Regions = *Regions;
+    Mapping.Buffers.push_back(std::move(BufferOrErr.get()));
+    return std::move(Mapping);
+}
+
+template <typename T>
+static void writeArray(raw_ostream &OS, ArrayRef<T> Array) {
+    size_t Size = Array.size() * sizeof(T);
+    OS.write(reinterpret_cast<const char*>(Array.data()), Size);
+    OS.write_zeros(alignTo(Size, CacheAlignment) - Size);
+}
+
+void MappingCache::save(StringRef Path, const BinaryMapping &Mapping) {
+    // Names and files are copied to one strings array. Offsets are 32 bit
+    std::string Strings;
+    bool Overflow = false;
+    auto addString = [&Strings, &Overflow](StringRef String) {
+        Overflow = Overflow || Strings.size() + String.size() > UINT32_MAX;
+        CacheString Result = {.Offset = uint32_t(Strings.size()), .Size = uint32_t(String.size())};
+        Strings.append(String.begin(), String.end());
+        return Result;
+    };
+
+    std::vector<CacheString> Files;
+    Files.reserve(Mapping.Files.size());
+    for (StringRef File : Mapping.Files) {
+        Files.push_back(addString(File));
+    }
+    std::vector<CacheFunction> Functions;
+    Functions.reserve(Mapping.Functions.size());
+    for (const auto &F : Mapping.Functions) {
+        Functions.push_back({
+            .NameHash = F.NameHash,
+            .Hash = F.Hash,
+            .Name = addString(F.Name),
+            .FilesBegin = F.FilesBegin,
+            .FilesSize = F.FilesSize,
+            .ExpressionsBegin = F.ExpressionsBegin,
+            .ExpressionsSize = F.ExpressionsSize,
+            .RegionsBegin = F.RegionsBegin,
+            .RegionsSize = F.RegionsSize
+        });
+    }
+    if (Overflow) {
+        return;
+    }
+
+    CacheHeader Header = {};
+    memcpy(Header.Magic, CacheMagic, sizeof(CacheMagic));
+    Header.Version = CacheVersion;
+    Header.LLVMVersion = LLVM_VERSION_MAJOR;
+    Header.ExpressionSize = sizeof(CounterExpression);
+    Header.RegionSize = sizeof(CounterMappingRegion);
+    // Arrays follow the header in the same order as written below
+    uint64_t Offset = alignTo(sizeof(CacheHeader), CacheAlignment);
+    auto place = [&Offset](size_t Count, size_t Size) {
+        CacheArray Array = {.Offset = Offset, .Count = Count};
+        Offset = alignTo(Offset + Count * Size, CacheAlignment);
+        return Array;
+    };
+    Header.Functions = place(Functions.size(), sizeof(CacheFunction));
+    Header.Files = place(Files.size(), sizeof(CacheString));
+    Header.FileIndexes = place(Mapping.FileIndexes.size(), sizeof(uint32_t));
+    Header.Expressions = place(Mapping.Expressions.size(), sizeof(CounterExpression));
+    Header.Regions = place(Mapping.Regions.size(), sizeof(CounterMappingRegion));
+    Header.Strings = place(Strings.size(), sizeof(char));
+
+    sys::fs::create_directories(sys::path::parent_path(Path));
+    int FD;
+    SmallString<256> TempPath;
+    if (sys::fs::createUniqueFile(Path + ".%%%%%%.tmp", FD, TempPath)) {
+        return;
+    }
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    writeArray(OS, ArrayRef(&Header, 1));
+    writeArray(OS, ArrayRef(Functions));
+    writeArray(OS, ArrayRef(Files));
+    writeArray(OS, Mapping.FileIndexes);
+    writeArray(OS, Mapping.Expressions);
+    writeArray(OS, Mapping.Regions);
+    writeArray(OS, ArrayRef(Strings.data(), Strings.size()));
+    OS.close();
+    if (OS.has_error()) {
+        // raw_fd_ostream aborts on unhandled errors
+        OS.clear_error();
+        sys::fs::remove(TempPath);
+        return;
+    }
+    // Concurrent writers produce the same file, last rename wins
+    if (sys::fs::rename(TempPath, Path)) {
+        sys::fs::remove(TempPath);
+    }
+}
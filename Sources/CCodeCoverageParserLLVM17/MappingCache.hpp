@@ -0,0 +1,37 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#pragma once
+#include "MappingTable.hpp"
+
+#include <optional>
+#include <string>
+
+namespace llvm17 {
+
+/// On-disk cache of the decoded binary mappings.
+/// Files are keyed by the binary UUID (build ID), path, size and modification time.
+/// Cache file layout matches the in-memory arrays, so it's mapped and used without decoding.
+/// Cache is an optimization: missing, stale or broken files are ignored and the binary is decoded.
+class MappingCache {
+public:
+    explicit MappingCache(llvm::StringRef Directory);
+
+    /// Cache file path for the binary. Empty if the binary identity can't be read
+    std::string path(llvm::StringRef Binary, llvm::MemoryBufferRef Contents) const;
+
+    /// Maps the cache file. Arrays and names of the mapping reference the mapped memory
+    static std::optional<BinaryMapping> load(llvm::StringRef Path);
+
+    /// Writes the mapping to the temporary file and renames it, so readers never see partial files.
+    /// Errors are ignored
+    static void save(llvm::StringRef Path, const BinaryMapping &Mapping);
+
+private:
+    std::string Directory;
+};
+
+}
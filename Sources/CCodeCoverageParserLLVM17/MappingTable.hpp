@@ -0,0 +1,149 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#pragma once
+#include "FileFilter.hpp"
+
+#include <llvm17/ADT/BitVector.h>
+#include <llvm17/ADT/DenseMap.h>
+#include <llvm17/ProfileData/Coverage/CoverageMappingReader.h>
+#include <llvm17/Support/MemoryBuffer.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace llvm17 {
+
+/// Decoded coverage mapping record of one function.
+/// Ranges are indexes in the arrays of the owning BinaryMapping.
+struct FunctionMapping {
+    llvm::StringRef Name;
+    // MD5 of the name. Profile records are matched by it
+    uint64_t NameHash;
+    uint64_t Hash;
+    // Index of the binary in the MappingTable
+    uint32_t Binary;
+    uint32_t FilesBegin;
+    uint32_t FilesSize;
+    uint32_t ExpressionsBegin;
+    uint32_t ExpressionsSize;
+    uint32_t RegionsBegin;
+    uint32_t RegionsSize;
+};
+
+/// Coverage mapping records of one binary.
+/// Functions and files are read on open, expressions and regions are decoded later on demand.
+/// Arrays are views of the decoded storage or of the mapped cache file, so moves keep them valid.
+struct BinaryMapping {
+    std::vector<FunctionMapping> Functions;
+    /// Unique source files of the binary, sorted by name
+    std::vector<llvm::StringRef> Files;
+    /// Indexes in Files for the file IDs of the function regions
+    llvm::ArrayRef<uint32_t> FileIndexes;
+    llvm::ArrayRef<llvm::coverage::CounterExpression> Expressions;
+    llvm::ArrayRef<llvm::coverage::CounterMappingRegion> Regions;
+
+    // Binary, readers or cache file own the memory for names, filenames and arrays
+    std::vector<std::unique_ptr<llvm::MemoryBuffer>> Buffers;
+    std::vector<std::unique_ptr<llvm::coverage::BinaryCoverageReader>> Readers;
+    // Decoded arrays. Empty for the mapped cache file
+    std::vector<uint32_t> FileIndexesStorage;
+    std::vector<llvm::coverage::CounterExpression> ExpressionsStorage;
+    std::vector<llvm::coverage::CounterMappingRegion> RegionsStorage;
+
+    /// Reads function records, filenames and files of the functions without decoding the regions
+    static llvm::Expected<BinaryMapping> open(std::unique_ptr<llvm::MemoryBuffer> Binary);
+
+    /// Decodes expressions and regions of all functions and sets their ranges
+    llvm::Error decode();
+};
+
+/// Table of the coverage mapping records of all binaries.
+/// Functions and files of all binaries are registered on load and never change.
+/// Regions of a binary are decoded when a profile executes its functions for the first time
+/// and are shared read-only between threads after that.
+class MappingTable {
+public:
+    /// Loads mappings of the binaries. Decoded mappings are stored in the cache directory
+    /// and mapped on the next load of the same binaries. Empty directory disables the cache.
+    /// Files are matched with the filter once, filtered files are never reported.
+    static llvm::Expected<MappingTable> load(std::vector<llvm::StringRef> &Binaries,
+                                             llvm::StringRef CacheDirectory = llvm::StringRef(),
+                                             const FileFilter &Filter = FileFilter());
+
+    llvm::ArrayRef<FunctionMapping> functions() const { return Functions; }
+
+    /// Indexes of the functions with provided name hash
+    llvm::ArrayRef<uint32_t> functions(uint64_t NameHash) const {
+        auto Found = NameIndex.find(NameHash);
+        return Found != NameIndex.end() ? llvm::ArrayRef<uint32_t>(Found->second) : llvm::ArrayRef<uint32_t>();
+    }
+
+    /// Unique source files of all binaries, sorted by name
+    llvm::ArrayRef<llvm::StringRef> files() const { return Files; }
+
+    /// Is the file with index in files() passed by the filter
+    bool isIncluded(uint32_t File) const { return IncludedFiles.test(File); }
+
+    /// Does the function have files passed by the filter. Files of the functions are read on load,
+    /// so it can be checked before decode. Binaries without included files are rejected without the file scan
+    bool isIncluded(const FunctionMapping &Function) const {
+        return Binaries[Function.Binary]->Included &&
+            llvm::any_of(files(Function), [this](uint32_t File) { return IncludedFiles.test(File); });
+    }
+
+    /// Decodes binaries of the functions if they aren't decoded yet. Thread safe.
+    /// Expressions and regions of the functions can be read after it succeeds
+    llvm::Error decode(llvm::ArrayRef<uint32_t> FunctionIndexes) const;
+
+    /// Indexes in files() for the file IDs of the function regions. Known before decode
+    llvm::ArrayRef<uint32_t> files(const FunctionMapping &Function) const {
+        return llvm::ArrayRef(Binaries[Function.Binary]->FileIndexes).slice(Function.FilesBegin, Function.FilesSize);
+    }
+
+    llvm::ArrayRef<llvm::coverage::CounterExpression> expressions(const FunctionMapping &Function) const {
+        return Binaries[Function.Binary]->Mapping.Expressions.slice(Function.ExpressionsBegin, Function.ExpressionsSize);
+    }
+
+    llvm::ArrayRef<llvm::coverage::CounterMappingRegion> regions(const FunctionMapping &Function) const {
+        return Binaries[Function.Binary]->Mapping.Regions.slice(Function.RegionsBegin, Function.RegionsSize);
+    }
+
+private:
+    struct LoadedBinary {
+        BinaryMapping Mapping;
+        // Binary files translated to the indexes in Files
+        std::vector<uint32_t> TableFiles;
+        // Binary file indexes translated to the indexes in Files
+        std::vector<uint32_t> FileIndexes;
+        // Index of the first binary function in Functions
+        uint32_t FunctionsBegin = 0;
+        // Decoded mapping is saved there. Empty if the cache is disabled or mapping is from the cache
+        std::string CachePath;
+        // Guards decoding. Published with the Decoded flag
+        std::mutex Lock;
+        std::atomic<bool> Decoded = false;
+        // Decoding error. Every profile with functions of the binary fails with it
+        std::string Error;
+        // Binary has files passed by the filter
+        bool Included = true;
+    };
+
+    std::vector<std::unique_ptr<LoadedBinary>> Binaries;
+    // Files of the functions are set on load, other ranges when their binary is decoded
+    mutable std::vector<FunctionMapping> Functions;
+    std::vector<llvm::StringRef> Files;
+    llvm::BitVector IncludedFiles;
+    llvm::DenseMap<uint64_t, llvm::SmallVector<uint32_t, 1>> NameIndex;
+
+    MappingTable() = default;
+    void add(std::unique_ptr<LoadedBinary> Binary);
+    void indexFiles(const FileFilter &Filter);
+    llvm::Error decode(LoadedBinary &Binary) const;
+    void publish(LoadedBinary &Binary) const;
+};
+
+}
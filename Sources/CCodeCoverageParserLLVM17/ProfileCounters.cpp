@@ -0,0 +1,195 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#include "ProfileCounters.hpp"
+#include <CCodeCoverageParser/CCodeCoverageParser.h>
+
+#include <llvm17/Support/Errc.h>
+#include <llvm17/Support/FileSystem.h>
+#include <llvm17/Support/MathExtras.h>
+#include <llvm17/Support/MemoryBuffer.h>
+#include <llvm17/Support/VirtualFileSystem.h>
+
+using namespace llvm17;
+using namespace llvm;
+
+Expected<ProfileCounters> ProfileCounters::read(StringRef Path) {
+    sys::fs::file_status Status;
+    // get status for file
+    sys::fs::status(Path, Status);
+    // check file is good
+    if (!sys::fs::exists(Status)) {
+        return make_error<StringError>(make_error_code(errc::no_such_file_or_directory),
+                                       "File not found");
+    }
+    if (!llvm::sys::fs::is_regular_file(Status)) {
+        return make_error<StringError>(make_error_code(errc::is_a_directory),
+                                       "Expected file, not the directory");
+    }
+    // Collector doesn't write binaries without executed code, so profile can be empty
+    if (Status.getSize() == 0) {
+        return ProfileCounters();
+    }
+
+    // Create reader for file
+    auto FS = llvm::vfs::getRealFileSystem();
+    return read(InstrProfReader::create(Path, *FS));
+}
+
+Expected<ProfileCounters> ProfileCounters::read(MemoryBufferRef Buffer) {
+    if (Buffer.getBufferSize() == 0) {
+        return ProfileCounters();
+    }
+    uint64_t Magic = 0;
+    if (Buffer.getBufferSize() >= sizeof(Magic)) {
+        memcpy(&Magic, Buffer.getBufferStart(), sizeof(Magic));
+    }
+    if (Magic == COVERAGE_SNAPSHOT_MAGIC) {
+        return readSnapshot(Buffer.getBuffer());
+    }
+    return read(InstrProfReader::create(MemoryBuffer::getMemBuffer(Buffer, /*RequiresNullTerminator=*/false)));
+}
+
+Expected<ProfileCounters> ProfileCounters::read(Expected<std::unique_ptr<InstrProfReader>> ReaderOrErr) {
+    if (Error E = ReaderOrErr.takeError()) {
+        return std::move(E);
+    }
+    auto Reader = std::move(ReaderOrErr.get());
+
+    ProfileCounters Profile;
+    Profile.SingleByteCoverage = Reader->hasSingleByteCoverage();
+
+    // Save counters of the executed functions.
+    // Not executed functions are skipped the same way as sparse InstrProfWriter does.
+    for (auto &I : *Reader) {
+        if (llvm::all_of(I.Counts, [](uint64_t Count) { return Count == 0; })) {
+            continue;
+        }
+        if (Error E = Profile.add(IndexedInstrProf::ComputeHash(I.Name), I.Hash, I.Counts)) {
+            return std::move(E);
+        }
+    }
+
+    // Handle reader errors. Could happen in the iteration
+    if (Reader->hasError()) {
+        if (Error E = Reader->getError()) {
+            return std::move(E);
+        }
+    }
+
+    return std::move(Profile);
+}
+
+// Snapshot has the same data records and counters as the raw profile, but without names.
+// Functions are matched by NameRef, which is the MD5 of the name.
+// Based on RawInstrProfReader::readNextRecord
+Expected<ProfileCounters> ProfileCounters::readSnapshot(StringRef Buffer) {
+    using ProfileData = RawInstrProf::ProfileData<uint64_t>;
+
+    ProfileCounters Profile;
+    SmallVector<uint64_t, 32> Counts;
+    while (!Buffer.empty()) {
+        CCoverageSnapshotHeader Header;
+        if (Buffer.size() < sizeof(Header)) {
+            return make_error<InstrProfError>(instrprof_error::truncated);
+        }
+        memcpy(&Header, Buffer.data(), sizeof(Header));
+        if (Header.magic != COVERAGE_SNAPSHOT_MAGIC) {
+            return make_error<InstrProfError>(instrprof_error::bad_magic);
+        }
+        // Data records layout depends on the raw profile version
+        if (Header.version != COVERAGE_SNAPSHOT_VERSION ||
+            GET_VERSION(Header.profile_version) != RawInstrProf::Version) {
+            return make_error<InstrProfError>(instrprof_error::unsupported_version);
+        }
+        uint64_t Size = alignTo(sizeof(Header) + Header.data_size + Header.counters_size, 8);
+        if (Header.data_size % sizeof(ProfileData) != 0 || Buffer.size() < Size) {
+            return make_error<InstrProfError>(instrprof_error::malformed,
+                                              "Corrupted snapshot of binary " + Twine(Header.binary_index));
+        }
+
+        bool SingleByte = Header.profile_version & VARIANT_MASK_BYTE_COVERAGE;
+        Profile.SingleByteCoverage = Profile.SingleByteCoverage || SingleByte;
+        size_t CounterSize = SingleByte ? sizeof(uint8_t) : sizeof(uint64_t);
+        const char *Data = Buffer.data() + sizeof(Header);
+        const char *CountersBegin = Data + Header.data_size;
+
+        for (uint64_t Offset = 0; Offset < Header.data_size; Offset += sizeof(ProfileData)) {
+            // Buffer can be unaligned. Data record has const members, so it's copied to the storage
+            alignas(ProfileData) char RecordStorage[sizeof(ProfileData)];
+            memcpy(RecordStorage, Data + Offset, sizeof(ProfileData));
+            const auto &Record = *reinterpret_cast<const ProfileData*>(RecordStorage);
+            // Counter pointer is relative to the address of the data record in the process
+            int64_t CountersOffset = int64_t(Record.CounterPtr) - int64_t(Header.counters_delta) + int64_t(Offset);
+            uint64_t CountersSize = uint64_t(Record.NumCounters) * CounterSize;
+            if (CountersOffset < 0 || CountersOffset + CountersSize > Header.counters_size) {
+                return make_error<InstrProfError>(instrprof_error::malformed,
+                                                  "Counters are out of range in binary " + Twine(Header.binary_index));
+            }
+            const char *Counters = CountersBegin + CountersOffset;
+
+            Counts.clear();
+            bool Executed = false;
+            for (uint32_t I = 0; I < Record.NumCounters; I++) {
+                uint64_t Count;
+                if (SingleByte) {
+                    // A value of zero signifies the block is covered
+                    Count = Counters[I] == 0 ? 1 : 0;
+                } else {
+                    memcpy(&Count, Counters + I * CounterSize, sizeof(Count));
+                }
+                Executed = Executed || Count != 0;
+                Counts.push_back(Count);
+            }
+            if (!Executed) {
+                continue;
+            }
+            if (Error E = Profile.add(Record.NameRef, Record.FuncHash, Counts)) {
+                return std::move(E);
+            }
+        }
+        Buffer = Buffer.drop_front(Size);
+    }
+    return std::move(Profile);
+}
+
+// Same function can come from the different raw profiles (binaries) in one file.
+// Counters are summed in this case like InstrProfWriter does.
+Error ProfileCounters::add(uint64_t NameHash, uint64_t FuncHash, ArrayRef<uint64_t> Counts) {
+    auto [It, Inserted] = Index.try_emplace({NameHash, FuncHash}, uint32_t(Records.size()));
+    if (Inserted) {
+        Records.push_back({NameHash, FuncHash, uint32_t(Counters.size()), uint32_t(Counts.size())});
+        llvm::append_range(Counters, Counts);
+        return Error::success();
+    }
+    auto &Record = Records[It->second];
+    if (Record.CountersSize != Counts.size()) {
+        return make_error<InstrProfError>(instrprof_error::count_mismatch);
+    }
+    for (size_t I = 0; I < Counts.size(); I++) {
+        uint64_t &Count = Counters[Record.CountersBegin + I];
+        Count = SaturatingAdd(Count, Counts[I]);
+    }
+    return Error::success();
+}
+
+Error ProfileCounters::merge(const ProfileCounters &Other) {
+    // Check all records first, so failed merge doesn't leave a half of the profile
+    for (const auto &Record : Other.Records) {
+        auto Found = Index.find({Record.NameHash, Record.FuncHash});
+        if (Found != Index.end() && Records[Found->second].CountersSize != Record.CountersSize) {
+            return make_error<InstrProfError>(instrprof_error::count_mismatch);
+        }
+    }
+    for (const auto &Record : Other.Records) {
+        auto Counts = ArrayRef(Other.Counters).slice(Record.CountersBegin, Record.CountersSize);
+        if (Error E = add(Record.NameHash, Record.FuncHash, Counts)) {
+            return E;
+        }
+    }
+    SingleByteCoverage = SingleByteCoverage || Other.SingleByteCoverage;
+    return Error::success();
+}
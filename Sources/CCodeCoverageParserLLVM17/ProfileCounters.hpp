@@ -0,0 +1,77 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#pragma once
+#include <llvm17/ADT/DenseMap.h>
+#include <llvm17/ProfileData/InstrProfReader.h>
+
+namespace llvm17 {
+
+/// Execution counters of the functions from the profile.
+/// Lightweight in-memory replacement for the IndexedInstrProfReader.
+/// Only functions with executed counters are stored.
+class ProfileCounters {
+public:
+    /// Empty counters. Profiles can be added to them with addProfile
+    ProfileCounters() = default;
+
+    /// Read any profile supported by InstrProfReader (raw profiles first of all)
+    static llvm::Expected<ProfileCounters> read(llvm::StringRef Path);
+
+    /// Read profile from memory. Buffer should be alive only for the call.
+    /// Raw profiles and counter snapshots from the collector are supported
+    static llvm::Expected<ProfileCounters> read(llvm::MemoryBufferRef Buffer);
+
+    /// Sum counters of the other profile into this one. Nothing is added on error
+    llvm::Error merge(const ProfileCounters &Other);
+
+    /// Counters of the function or empty array if function wasn't executed
+    llvm::ArrayRef<uint64_t> counters(uint64_t NameHash, uint64_t FuncHash) const {
+        auto Found = Index.find({NameHash, FuncHash});
+        if (Found == Index.end()) {
+            return llvm::ArrayRef<uint64_t>();
+        }
+        auto &Record = Records[Found->second];
+        return llvm::ArrayRef(Counters).slice(Record.CountersBegin, Record.CountersSize);
+    }
+
+    /// Calls provided function for each executed function (name hash, function hash)
+    template <typename F>
+    void forEachFunction(F &&Callback) const {
+        for (const auto &Record : Records) {
+            Callback(Record.NameHash, Record.FuncHash);
+        }
+    }
+
+    bool hasSingleByteCoverage() const { return SingleByteCoverage; }
+
+    /// Count of the executed functions
+    size_t size() const { return Records.size(); }
+
+    /// Bytes allocated for the records and counters
+    size_t allocatedSize() const {
+        return Records.capacity() * sizeof(Record) + Counters.capacity() * sizeof(uint64_t) + Index.getMemorySize();
+    }
+
+private:
+    struct Record {
+        uint64_t NameHash;
+        uint64_t FuncHash;
+        uint32_t CountersBegin;
+        uint32_t CountersSize;
+    };
+
+    std::vector<Record> Records;
+    std::vector<uint64_t> Counters;
+    llvm::DenseMap<std::pair<uint64_t, uint64_t>, uint32_t> Index;
+    bool SingleByteCoverage = false;
+
+    static llvm::Expected<ProfileCounters> read(llvm::Expected<std::unique_ptr<llvm::InstrProfReader>> ReaderOrErr);
+    static llvm::Expected<ProfileCounters> readSnapshot(llvm::StringRef Buffer);
+    llvm::Error add(uint64_t NameHash, uint64_t FuncHash, llvm::ArrayRef<uint64_t> Counts);
+};
+
+}
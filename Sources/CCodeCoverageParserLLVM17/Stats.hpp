@@ -0,0 +1,42 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#pragma once
+#include <CCodeCoverageParser/CCodeCoverageParser.h>
+
+#include <chrono>
+
+namespace llvm17 {
+
+/// Adds duration of the scope to the phase counter of the stats.
+/// Clock isn't read without the counter, so parsing without stats pays only for the check
+class PhaseTimer {
+public:
+    explicit PhaseTimer(uint64_t *Counter): Counter(Counter) {
+        if (Counter) {
+            Start = std::chrono::steady_clock::now();
+        }
+    }
+
+    PhaseTimer(CCoverageStats *Stats, uint64_t CCoverageStats::*Phase):
+        PhaseTimer(Stats ? &(Stats->*Phase) : nullptr) {}
+
+    ~PhaseTimer() {
+        if (Counter) {
+            auto Elapsed = std::chrono::steady_clock::now() - Start;
+            *Counter += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Elapsed).count());
+        }
+    }
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    uint64_t *Counter;
+    std::chrono::steady_clock::time_point Start;
+};
+
+}
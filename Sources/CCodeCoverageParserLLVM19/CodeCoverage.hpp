@@ -6,23 +6,66 @@
 
 #pragma once
 #include <CCodeCoverageParser/CCodeCoverageParser.h>
-#include <llvm19/ProfileData/Coverage/CoverageMapping.h>
-#include <llvm19/ProfileData/Coverage/CoverageMappingReader.h>
-#include <llvm19/Support/MemoryBuffer.h>
+#include "MappingTable.hpp"
+#include "ThreadPool.hpp"
 
 namespace llvm19 {
 
+class ProfileCounters;
+class ProfileCoverage;
+
 /// The implementation of the coverage tool.
 class CodeCoverage {
 public:
-    static llvm::Expected<CodeCoverage> load(std::vector<llvm::StringRef> &Binaries);
-    llvm::Expected<CCoverageFiles> coverage(llvm::StringRef ProfrawPath) const;
+    static llvm::Expected<CodeCoverage> load(std::vector<llvm::StringRef> &Binaries,
+                                             const CCoverageParserOptions &Options);
+    /// Phase counters are added to the stats if they are set
+    llvm::Expected<CCoverageFiles> coverage(llvm::StringRef ProfrawPath, CCoverageStats *Stats = nullptr) const;
+    llvm::Expected<CCoverageFiles> coverage(llvm::MemoryBufferRef Profile, CCoverageStats *Stats = nullptr) const;
+    llvm::Expected<CCoverageFiles> coverage(const ProfileCounters &Profile) const;
+    llvm::Expected<CCoverageFiles> coverage(const ProfileCounters &Profile, const ProfileCounters &Baseline,
+                                            CCoverageBaselineMode Mode) const;
+    llvm::Error visit(llvm::StringRef ProfrawPath, const CCoverageVisitor &Visitor) const;
+    llvm::Error visit(llvm::MemoryBufferRef Profile, const CCoverageVisitor &Visitor) const;
+    llvm::Error visit(const ProfileCounters &Profile, const CCoverageVisitor &Visitor) const;
+    llvm::Expected<CCoverageLines> lines(llvm::StringRef ProfrawPath, bool WithCounts) const;
+    llvm::Expected<CCoverageLines> lines(llvm::MemoryBufferRef Profile, bool WithCounts) const;
+    llvm::Expected<CCoverageLines> lines(const ProfileCounters &Profile, bool WithCounts) const;
+    llvm::Expected<CCoverageTouched> touched(llvm::StringRef ProfrawPath) const;
+    llvm::Expected<CCoverageTouched> touched(llvm::MemoryBufferRef Profile) const;
+    llvm::Expected<CCoverageTouched> touched(const ProfileCounters &Profile) const;
+    /// Merges results of many profiles into one. Files are merged in parallel on the pool threads
+    static CCoverageFiles merge(llvm::ArrayRef<CCoverageFiles> Results, ThreadPool &Pool);
+    static void free(CCoverageFiles Files);
+    static void free(CCoverageLines Lines);
+    static void free(CCoverageTouched Touched);
 private:
-    std::vector<std::unique_ptr<llvm::coverage::BinaryCoverageReader>> MappingReaders;
+    MappingTable Mappings;
+    
+    CodeCoverage(MappingTable Mappings);
+    llvm::Expected<CCoverageFiles> coverageFiles(const ProfileCounters &Profile,
+                                                 const ProfileCounters *Baseline,
+                                                 CCoverageBaselineMode Mode,
+                                                 CCoverageStats *Stats = nullptr) const;
+    static CCoverageSegment segment(const llvm::coverage::CoverageSegment &Segment);
+    static void processLines(llvm::ArrayRef<llvm::coverage::CoverageSegment> CoverageForFile,
+                             uint64_t *Coverable, uint64_t *Covered, uint64_t *Counts);
+    
+    /// Covered regions of the files, stored by columns like in the result
+    struct Regions {
+        std::vector<uint32_t> StartLines;
+        std::vector<uint32_t> StartColumns;
+        std::vector<uint32_t> EndLines;
+        std::vector<uint32_t> EndColumns;
+        std::vector<uint64_t> Counts;
+        
+        size_t size() const { return Counts.size(); }
+        void add(uint32_t StartLine, uint32_t StartColumn, uint32_t EndLine, uint32_t EndColumn, uint64_t Count);
+    };
     
-    CodeCoverage(std::vector<std::unique_ptr<llvm::coverage::BinaryCoverageReader>> readers);
-    llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> readProfile(llvm::StringRef ProfrawPath) const;
-    CCoverageFile processFile(llvm::StringRef Name, llvm::coverage::CoverageMapping &Coverage) const;
+    static void processRegions(llvm::ArrayRef<llvm::coverage::CoverageSegment> CoverageForFile, Regions &Result);
+    static void mergeFile(llvm::ArrayRef<const CCoverageFile*> Files, Regions &Result);
+    static CCoverageFiles files(llvm::ArrayRef<llvm::StringRef> Names, llvm::ArrayRef<Regions> FileRegions);
 };
 
 }
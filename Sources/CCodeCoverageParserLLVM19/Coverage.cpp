@@ -6,6 +6,11 @@
 
 #include <CCodeCoverageParser/CCodeCoverageParser.h>
 #include "CodeCoverage.hpp"
+#include "ProfileCounters.hpp"
+#include "ThreadPool.hpp"
+
+#include <memory>
+#include <mutex>
 
 using namespace llvm;
 using namespace llvm19;
@@ -14,9 +19,25 @@ extern "C" {
     struct CCoverageParserLLMV19 {
         struct CCoverageParser super;
         CodeCoverage coverage;
+        // Threads for batch parsing. Shared by all batch calls
+        mutable ThreadPool pool;
+        // Baseline for the relative coverage. Replaced as a whole, parsing calls keep their reference
+        mutable std::shared_ptr<const ProfileCounters> baseline;
+        mutable std::mutex baselineLock;
         
         CCoverageParserLLMV19(CodeCoverage c, struct CCoverageParser s): coverage(std::move(c)), super(s) {}
     };
+    
+    struct CCoverageAccumulatorLLMV19 {
+        struct CCoverageAccumulator super;
+        const CodeCoverage *coverage;
+        // Summed counters of all added profiles. Size depends only on the executed functions count
+        ProfileCounters counters;
+        // Profiles are read in parallel, only merge is serialized
+        mutable std::mutex lock;
+        
+        CCoverageAccumulatorLLMV19(const CodeCoverage *c, struct CCoverageAccumulator s): coverage(c), super(s) {}
+    };
 }
 
 static char* copyString(const char* str, size_t len) {
@@ -31,23 +52,291 @@ static const char* errorMessage(Error E) {
     return copyString(str.data(), str.size());
 }
 
+static CCoverageFilesResult filesResult(Expected<CCoverageFiles> CoverageOrErr) {
+    if (Error E = CoverageOrErr.takeError()) {
+        return CCoverageFilesResult({
+            .is_error = true,
+            .error = errorMessage(std::move(E))
+        });
+    }
+    
+    return CCoverageFilesResult({.is_error = false, .files = CoverageOrErr.get()});
+}
+
 // C wrapper for coverage() method
 LLVM_ATTRIBUTE_NOINLINE
 static CCoverageFilesResult cp_covered_files(const struct CCoverageParser* self,
                                              const char* profraw_file)
 {
-    
     auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
-    auto CoverageOrErr = sself->coverage.coverage(profraw_file);
-    
-    if (Error E = CoverageOrErr.takeError()) {
-        return CCoverageFilesResult({
+    return filesResult(sself->coverage.coverage(profraw_file));
+}
+
+// C wrapper for coverage() of the profile in memory
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageFilesResult cp_covered_files_in_buffer(const struct CCoverageParser* self,
+                                                       const void* data, size_t size)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    MemoryBufferRef Buffer(StringRef(static_cast<const char*>(data), size), "profile");
+    return filesResult(sself->coverage.coverage(Buffer));
+}
+
+// C wrapper for coverage() with the phase counters
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageFilesResult cp_covered_files_with_stats(const struct CCoverageParser* self,
+                                                        const char* profraw_file, CCoverageStats* stats)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    return filesResult(sself->coverage.coverage(profraw_file, stats));
+}
+
+// C wrapper for coverage() of the profile in memory with the phase counters
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageFilesResult cp_covered_files_in_buffer_with_stats(const struct CCoverageParser* self,
+                                                                  const void* data, size_t size,
+                                                                  CCoverageStats* stats)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    MemoryBufferRef Buffer(StringRef(static_cast<const char*>(data), size), "profile");
+    return filesResult(sself->coverage.coverage(Buffer, stats));
+}
+
+static const char* errorOrNull(Error E) {
+    if (E) {
+        return errorMessage(std::move(E));
+    }
+    return nullptr;
+}
+
+// C wrapper for visit() method
+LLVM_ATTRIBUTE_NOINLINE
+static const char* cp_visit_covered_files(const struct CCoverageParser* self,
+                                          const char* profraw_file,
+                                          const CCoverageVisitor* visitor)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    return errorOrNull(sself->coverage.visit(profraw_file, *visitor));
+}
+
+// C wrapper for visit() of the profile in memory
+LLVM_ATTRIBUTE_NOINLINE
+static const char* cp_visit_covered_files_in_buffer(const struct CCoverageParser* self,
+                                                    const void* data, size_t size,
+                                                    const CCoverageVisitor* visitor)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    MemoryBufferRef Buffer(StringRef(static_cast<const char*>(data), size), "profile");
+    return errorOrNull(sself->coverage.visit(Buffer, *visitor));
+}
+
+static CCoverageLinesResult linesResult(Expected<CCoverageLines> LinesOrErr) {
+    if (Error E = LinesOrErr.takeError()) {
+        return CCoverageLinesResult({
             .is_error = true,
             .error = errorMessage(std::move(E))
         });
     }
-    
-    return CCoverageFilesResult({.is_error = false, .files = CoverageOrErr.get()});
+    return CCoverageLinesResult({.is_error = false, .lines = LinesOrErr.get()});
+}
+
+// C wrapper for lines() method
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageLinesResult cp_covered_lines(const struct CCoverageParser* self,
+                                             const char* profraw_file, bool with_counts)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    return linesResult(sself->coverage.lines(profraw_file, with_counts));
+}
+
+// C wrapper for lines() of the profile in memory
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageLinesResult cp_covered_lines_in_buffer(const struct CCoverageParser* self,
+                                                       const void* data, size_t size, bool with_counts)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    MemoryBufferRef Buffer(StringRef(static_cast<const char*>(data), size), "profile");
+    return linesResult(sself->coverage.lines(Buffer, with_counts));
+}
+
+// C wrapper for free of lines
+LLVM_ATTRIBUTE_NOINLINE
+static void cp_free_lines_result(const struct CCoverageParser* self, CCoverageLines lines) {
+    CodeCoverage::free(lines);
+}
+
+static CCoverageTouchedResult touchedResult(Expected<CCoverageTouched> TouchedOrErr) {
+    if (Error E = TouchedOrErr.takeError()) {
+        return CCoverageTouchedResult({
+            .is_error = true,
+            .error = errorMessage(std::move(E))
+        });
+    }
+    return CCoverageTouchedResult({.is_error = false, .touched = TouchedOrErr.get()});
+}
+
+// C wrapper for touched() method
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageTouchedResult cp_touched_files(const struct CCoverageParser* self, const char* profraw_file) {
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    return touchedResult(sself->coverage.touched(profraw_file));
+}
+
+// C wrapper for touched() of the profile in memory
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageTouchedResult cp_touched_files_in_buffer(const struct CCoverageParser* self,
+                                                         const void* data, size_t size)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    MemoryBufferRef Buffer(StringRef(static_cast<const char*>(data), size), "profile");
+    return touchedResult(sself->coverage.touched(Buffer));
+}
+
+// C wrapper for free of touched files
+LLVM_ATTRIBUTE_NOINLINE
+static void cp_free_touched_result(const struct CCoverageParser* self, CCoverageTouched touched) {
+    CodeCoverage::free(touched);
+}
+
+static const char* setBaseline(const struct CCoverageParser* self, Expected<ProfileCounters> ProfileOrErr) {
+    if (Error E = ProfileOrErr.takeError()) {
+        return errorMessage(std::move(E));
+    }
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    auto baseline = std::make_shared<const ProfileCounters>(std::move(ProfileOrErr.get()));
+    std::lock_guard<std::mutex> Lock(sself->baselineLock);
+    sself->baseline = std::move(baseline);
+    return nullptr;
+}
+
+// C wrapper for baseline from the profraw file
+LLVM_ATTRIBUTE_NOINLINE
+static const char* cp_set_baseline(const struct CCoverageParser* self, const char* profraw_file) {
+    return setBaseline(self, ProfileCounters::read(profraw_file));
+}
+
+// C wrapper for baseline from the profile in memory
+LLVM_ATTRIBUTE_NOINLINE
+static const char* cp_set_baseline_in_buffer(const struct CCoverageParser* self, const void* data, size_t size) {
+    MemoryBufferRef Buffer(StringRef(static_cast<const char*>(data), size), "profile");
+    return setBaseline(self, ProfileCounters::read(Buffer));
+}
+
+static CCoverageFilesResult relativeFilesResult(const struct CCoverageParser* self,
+                                                Expected<ProfileCounters> ProfileOrErr,
+                                                CCoverageBaselineMode mode)
+{
+    if (Error E = ProfileOrErr.takeError()) {
+        return filesResult(std::move(E));
+    }
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    std::shared_ptr<const ProfileCounters> baseline;
+    {
+        std::lock_guard<std::mutex> Lock(sself->baselineLock);
+        baseline = sself->baseline;
+    }
+    if (!baseline) {
+        return filesResult(sself->coverage.coverage(ProfileOrErr.get()));
+    }
+    return filesResult(sself->coverage.coverage(ProfileOrErr.get(), *baseline, mode));
+}
+
+// C wrapper for coverage() relative to the baseline
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageFilesResult cp_covered_files_relative(const struct CCoverageParser* self,
+                                                      const char* profraw_file, CCoverageBaselineMode mode)
+{
+    return relativeFilesResult(self, ProfileCounters::read(profraw_file), mode);
+}
+
+// C wrapper for coverage() of the profile in memory relative to the baseline
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageFilesResult cp_covered_files_in_buffer_relative(const struct CCoverageParser* self,
+                                                                const void* data, size_t size,
+                                                                CCoverageBaselineMode mode)
+{
+    MemoryBufferRef Buffer(StringRef(static_cast<const char*>(data), size), "profile");
+    return relativeFilesResult(self, ProfileCounters::read(Buffer), mode);
+}
+
+// C wrapper for merge() of the results
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageFiles cp_merge_results(const struct CCoverageParser* self,
+                                       const CCoverageFiles* results, size_t count)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    return CodeCoverage::merge(ArrayRef<CCoverageFiles>(results, count), sself->pool);
+}
+
+// C wrapper for parallel coverage() calls
+LLVM_ATTRIBUTE_NOINLINE
+static void cp_covered_files_batch(const struct CCoverageParser* self,
+                                   const char* const* profraw_files, size_t count,
+                                   void* context, CCoverageFilesCallback callback)
+{
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    // Mapping table is immutable, so all threads are sharing it
+    sself->pool.parallelFor(count, [&](size_t index) {
+        callback(context, index, filesResult(sself->coverage.coverage(profraw_files[index])));
+    });
+}
+
+static const char* addCounters(struct CCoverageAccumulator* self, Expected<ProfileCounters> ProfileOrErr) {
+    if (Error E = ProfileOrErr.takeError()) {
+        return errorMessage(std::move(E));
+    }
+    auto sself = reinterpret_cast<struct CCoverageAccumulatorLLMV19*>(self);
+    std::lock_guard<std::mutex> Lock(sself->lock);
+    if (Error E = sself->counters.merge(ProfileOrErr.get())) {
+        return errorMessage(std::move(E));
+    }
+    return nullptr;
+}
+
+// C wrapper for adding of the profraw file
+LLVM_ATTRIBUTE_NOINLINE
+static const char* ca_add_file(struct CCoverageAccumulator* self, const char* profraw_file) {
+    return addCounters(self, ProfileCounters::read(profraw_file));
+}
+
+// C wrapper for adding of the profile from memory
+LLVM_ATTRIBUTE_NOINLINE
+static const char* ca_add_buffer(struct CCoverageAccumulator* self, const void* data, size_t size) {
+    MemoryBufferRef Buffer(StringRef(static_cast<const char*>(data), size), "profile");
+    return addCounters(self, ProfileCounters::read(Buffer));
+}
+
+// C wrapper for coverage() of the summed counters
+LLVM_ATTRIBUTE_NOINLINE
+static CCoverageFilesResult ca_finalize(const struct CCoverageAccumulator* self) {
+    auto sself = reinterpret_cast<const struct CCoverageAccumulatorLLMV19*>(self);
+    std::lock_guard<std::mutex> Lock(sself->lock);
+    return filesResult(sself->coverage->coverage(sself->counters));
+}
+
+// C wrapper for delete
+LLVM_ATTRIBUTE_NOINLINE
+static void ca_destroy(struct CCoverageAccumulator* self) {
+    delete reinterpret_cast<struct CCoverageAccumulatorLLMV19*>(self);
+}
+
+// C wrapper for accumulator constructor
+LLVM_ATTRIBUTE_NOINLINE
+static struct CCoverageAccumulator* cp_create_accumulator(const struct CCoverageParser* self) {
+    auto sself = reinterpret_cast<const struct CCoverageParserLLMV19*>(self);
+    CCoverageAccumulator super;
+    super.add_file = &ca_add_file;
+    super.add_buffer = &ca_add_buffer;
+    super.finalize = &ca_finalize;
+    super.destroy = &ca_destroy;
+    auto accumulator = new CCoverageAccumulatorLLMV19(&sself->coverage, super);
+    return reinterpret_cast<struct CCoverageAccumulator*>(accumulator);
+}
+
+// C wrapper for result free
+LLVM_ATTRIBUTE_NOINLINE
+static void cp_free_result(const struct CCoverageParser* self, CCoverageFiles files) {
+    CodeCoverage::free(files);
 }
 
 // C wrapper for delete
@@ -58,13 +347,15 @@ static void cp_destroy(struct CCoverageParser* self) {
 
 
 LLVM_ATTRIBUTE_NOINLINE
-CCoverageParserResult cl_create_processor(const char* _Nonnull const* _Nonnull binaries, uint32_t count) {
+CCoverageParserResult cl_create_processor_with_options(const char* _Nonnull const* _Nonnull binaries, uint32_t count,
+                                                      const CCoverageParserOptions* _Nonnull options)
+{
     std::vector<StringRef> sbinaries;
     sbinaries.reserve(count);
     for (const auto &binary: ArrayRef<const char*>(binaries, count)) {
         sbinaries.push_back(binary);
     }
-    auto coverage = CodeCoverage::load(sbinaries);
+    auto coverage = CodeCoverage::load(sbinaries, *options);
     if (Error E = coverage.takeError()) {
         return CCoverageParserResult({
             .is_error = true,
@@ -77,7 +368,26 @@ CCoverageParserResult cl_create_processor(const char* _Nonnull const* _Nonnull b
     /// It will work like the object
     CCoverageParser super;
     super.covered_files = &cp_covered_files;
+    super.covered_files_in_buffer = &cp_covered_files_in_buffer;
+    super.covered_files_batch = &cp_covered_files_batch;
+    super.free_result = &cp_free_result;
+    super.create_accumulator = &cp_create_accumulator;
     super.destroy = &cp_destroy;
+    super.visit_covered_files = &cp_visit_covered_files;
+    super.visit_covered_files_in_buffer = &cp_visit_covered_files_in_buffer;
+    super.covered_lines = &cp_covered_lines;
+    super.covered_lines_in_buffer = &cp_covered_lines_in_buffer;
+    super.free_lines_result = &cp_free_lines_result;
+    super.merge_results = &cp_merge_results;
+    super.touched_files = &cp_touched_files;
+    super.touched_files_in_buffer = &cp_touched_files_in_buffer;
+    super.free_touched_result = &cp_free_touched_result;
+    super.set_baseline = &cp_set_baseline;
+    super.set_baseline_in_buffer = &cp_set_baseline_in_buffer;
+    super.covered_files_relative = &cp_covered_files_relative;
+    super.covered_files_in_buffer_relative = &cp_covered_files_in_buffer_relative;
+    super.covered_files_with_stats = &cp_covered_files_with_stats;
+    super.covered_files_in_buffer_with_stats = &cp_covered_files_in_buffer_with_stats;
     auto processor = new CCoverageParserLLMV19(std::move(coverage.get()), super);
     
     return CCoverageParserResult({
@@ -86,7 +396,14 @@ CCoverageParserResult cl_create_processor(const char* _Nonnull const* _Nonnull b
     });
 }
 
+LLVM_ATTRIBUTE_NOINLINE
+CCoverageParserResult cl_create_processor(const char* _Nonnull const* _Nonnull binaries, uint32_t count) {
+    CCoverageParserOptions options = {};
+    return cl_create_processor_with_options(binaries, count, &options);
+}
+
 const struct CCoverageParserLibrary coverage_parser_library_instance = {
     .llvm_version = LLVM_VERSION_STRING,
-    .create_parser = &cl_create_processor
+    .create_parser = &cl_create_processor,
+    .create_parser_with_options = &cl_create_processor_with_options
 };
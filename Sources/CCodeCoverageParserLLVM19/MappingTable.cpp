@@ -0,0 +1,302 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#include "MappingTable.hpp"
+#include "MappingCache.hpp"
+
+#include <llvm19/ProfileData/InstrProf.h>
+#include <llvm19/Support/LEB128.h>
+
+#include <optional>
+
+using namespace llvm19;
+using namespace llvm;
+using namespace coverage;
+
+Expected<MappingTable> MappingTable::load(std::vector<StringRef> &Binaries, StringRef CacheDirectory,
+                                          const FileFilter &Filter)
+{
+    MappingTable Table;
+    std::optional<MappingCache> Cache;
+    if (!CacheDirectory.empty()) {
+        Cache.emplace(CacheDirectory);
+    }
+
+    for (const auto &Path : Binaries) {
+        // Create memory buffer for binary file
+        auto CovMappingBufOrErr = MemoryBuffer::getFileOrSTDIN(
+            Path, /*IsText=*/false, /*RequiresNullTerminator=*/false
+        );
+        // Handle errors
+        if (std::error_code EC = CovMappingBufOrErr.getError()) {
+            return make_error<StringError>(EC, "Can't read file");
+        }
+        auto Binary = std::make_unique<LoadedBinary>();
+        // Cache is keyed by the binary identity. Empty path if it can't be read
+        std::string CachePath = Cache ? Cache->path(Path, CovMappingBufOrErr.get()->getMemBufferRef()) : "";
+        std::optional<BinaryMapping> Cached;
+        if (!CachePath.empty()) {
+            Cached = MappingCache::load(CachePath);
+        }
+        if (Cached) {
+            Binary->Mapping = std::move(*Cached);
+        } else {
+            // Regions are decoded on the first profile which executes functions of the binary
+            auto MappingOrErr = BinaryMapping::open(std::move(CovMappingBufOrErr.get()));
+            if (Error E = MappingOrErr.takeError()) {
+                return std::move(E);
+            }
+            Binary->Mapping = std::move(MappingOrErr.get());
+            Binary->CachePath = std::move(CachePath);
+        }
+        Table.add(std::move(Binary));
+    }
+
+    Table.indexFiles(Filter);
+    // Mappings from the cache are decoded already
+    for (auto &Binary : Table.Binaries) {
+        if (Binary->Mapping.Readers.empty()) {
+            Table.publish(*Binary);
+        }
+    }
+    return std::move(Table);
+}
+
+void MappingTable::add(std::unique_ptr<LoadedBinary> Binary) {
+    uint32_t Index = uint32_t(Binaries.size());
+    Binary->FunctionsBegin = uint32_t(Functions.size());
+    Functions.reserve(Functions.size() + Binary->Mapping.Functions.size());
+    for (const auto &Function : Binary->Mapping.Functions) {
+        NameIndex[Function.NameHash].push_back(uint32_t(Functions.size()));
+        Functions.push_back(Function);
+        Functions.back().Binary = Index;
+    }
+    Binaries.push_back(std::move(Binary));
+}
+
+// Every file gets one index for the whole binary set, so files of the functions
+// are matched by the integer and not by the name comparison.
+// Indexes are sorted the same way as the file names. Filter is applied once per file here.
+void MappingTable::indexFiles(const FileFilter &Filter) {
+    for (const auto &Binary : Binaries) {
+        llvm::append_range(Files, Binary->Mapping.Files);
+    }
+    llvm::sort(Files);
+    Files.erase(std::unique(Files.begin(), Files.end()), Files.end());
+
+    IncludedFiles.resize(Files.size(), Filter.empty());
+    if (!Filter.empty()) {
+        for (size_t Index = 0; Index < Files.size(); Index++) {
+            if (Filter.includes(Files[Index])) {
+                IncludedFiles.set(Index);
+            }
+        }
+    }
+
+    // Binary files are sorted and unique, so they are translated once
+    for (auto &Binary : Binaries) {
+        Binary->TableFiles.reserve(Binary->Mapping.Files.size());
+        for (StringRef Filename : Binary->Mapping.Files) {
+            auto Found = llvm::lower_bound(Files, Filename);
+            Binary->TableFiles.push_back(uint32_t(std::distance(Files.begin(), Found)));
+        }
+        Binary->Included = Filter.empty() || llvm::any_of(Binary->TableFiles, [this](uint32_t File) {
+            return IncludedFiles.test(File);
+        });
+        // Function files are read on open, so they are known before decode
+        Binary->FileIndexes.reserve(Binary->Mapping.FileIndexes.size());
+        for (uint32_t Local : Binary->Mapping.FileIndexes) {
+            Binary->FileIndexes.push_back(Binary->TableFiles[Local]);
+        }
+    }
+}
+
+Error MappingTable::decode(ArrayRef<uint32_t> FunctionIndexes) const {
+    for (uint32_t Index : FunctionIndexes) {
+        auto &Binary = *Binaries[Functions[Index].Binary];
+        // Binary was decoded by this or an earlier profile
+        if (Binary.Decoded.load(std::memory_order_acquire)) {
+            continue;
+        }
+        if (Error E = decode(Binary)) {
+            return E;
+        }
+    }
+    return Error::success();
+}
+
+Error MappingTable::decode(LoadedBinary &Binary) const {
+    std::lock_guard<std::mutex> Guard(Binary.Lock);
+    if (Binary.Decoded.load(std::memory_order_relaxed)) {
+        return Error::success();
+    }
+    if (Binary.Error.empty()) {
+        if (Error E = Binary.Mapping.decode()) {
+            Binary.Error = toString(std::move(E));
+        }
+    }
+    if (!Binary.Error.empty()) {
+        return make_error<StringError>(Binary.Error, inconvertibleErrorCode());
+    }
+    if (!Binary.CachePath.empty()) {
+        MappingCache::save(Binary.CachePath, Binary.Mapping);
+    }
+    publish(Binary);
+    return Error::success();
+}
+
+// Sets ranges of the decoded binary functions in the table. Functions of other binaries can be
+// read concurrently, ranges of these functions are read only after the Decoded flag is set.
+void MappingTable::publish(LoadedBinary &Binary) const {
+    for (size_t Index = 0; Index < Binary.Mapping.Functions.size(); Index++) {
+        const auto &Decoded = Binary.Mapping.Functions[Index];
+        auto &Function = Functions[Binary.FunctionsBegin + Index];
+        Function.ExpressionsBegin = Decoded.ExpressionsBegin;
+        Function.ExpressionsSize = Decoded.ExpressionsSize;
+        Function.RegionsBegin = Decoded.RegionsBegin;
+        Function.RegionsSize = Decoded.RegionsSize;
+    }
+    // Table keeps the only copy of the records
+    Binary.Mapping.Functions = std::vector<FunctionMapping>();
+    Binary.Decoded.store(true, std::memory_order_release);
+}
+
+// Reads only the file mapping at the start of the encoded function record: number of files
+// and indexes in the filenames of the translation unit, all ULEB128.
+// Based on RawCoverageMappingReader::read
+static Error readFileIndexes(StringRef Data, size_t FilenamesCount, SmallVectorImpl<uint32_t> &Indexes) {
+    auto *Current = reinterpret_cast<const uint8_t*>(Data.data());
+    auto *End = Current + Data.size();
+    auto readULEB128 = [&](uint64_t &Result) -> Error {
+        unsigned Length = 0;
+        const char *ErrorMessage = nullptr;
+        Result = decodeULEB128(Current, &Length, End, &ErrorMessage);
+        if (ErrorMessage) {
+            return make_error<CoverageMapError>(coveragemap_error::truncated);
+        }
+        Current += Length;
+        return Error::success();
+    };
+
+    uint64_t Count;
+    if (Error E = readULEB128(Count)) {
+        return E;
+    }
+    if (Count > uint64_t(End - Current)) {
+        return make_error<CoverageMapError>(coveragemap_error::malformed);
+    }
+    for (uint64_t I = 0; I < Count; I++) {
+        uint64_t Index;
+        if (Error E = readULEB128(Index)) {
+            return E;
+        }
+        if (Index >= FilenamesCount) {
+            return make_error<CoverageMapError>(coveragemap_error::malformed);
+        }
+        Indexes.push_back(uint32_t(Index));
+    }
+    return Error::success();
+}
+
+Expected<BinaryMapping> BinaryMapping::open(std::unique_ptr<MemoryBuffer> Binary) {
+    BinaryMapping Mapping;
+    std::vector<StringRef> Filenames;
+
+    SmallVector<std::unique_ptr<MemoryBuffer>, 4> Buffers;
+    // Create binary readers for this binary file
+    auto CoverageReadersOrErr = BinaryCoverageReader::create(Binary->getMemBufferRef(), StringRef(), Buffers);
+    // handle errors
+    if (Error E = CoverageReadersOrErr.takeError()) {
+        return std::move(E);
+    }
+    // register records and save binary readers to the instance. Readers only reference the encoded mapping
+    for (auto &Reader : CoverageReadersOrErr.get()) {
+        llvm::append_range(Filenames, Reader->getFilenamesRef());
+        for (const auto &R : Reader->getMappingRecordsRef()) {
+            Mapping.Functions.push_back({
+                .Name = R.FunctionName,
+                .NameHash = IndexedInstrProf::ComputeHash(R.FunctionName),
+                .Hash = R.FunctionHash,
+                .Binary = 0,
+                .FilesBegin = 0,
+                .FilesSize = 0,
+                .ExpressionsBegin = 0,
+                .ExpressionsSize = 0,
+                .RegionsBegin = 0,
+                .RegionsSize = 0
+            });
+        }
+        Mapping.Readers.push_back(std::move(Reader));
+    }
+    // keep binary memory alive, records are referencing it
+    Mapping.Buffers.push_back(std::move(Binary));
+    for (auto &Buffer : Buffers) {
+        Mapping.Buffers.push_back(std::move(Buffer));
+    }
+
+    Mapping.Files = std::move(Filenames);
+    llvm::sort(Mapping.Files);
+    Mapping.Files.erase(std::unique(Mapping.Files.begin(), Mapping.Files.end()), Mapping.Files.end());
+
+    // Files of the functions are read without decoding the regions, so they are known before decode
+    SmallVector<uint32_t, 8> FunctionFiles;
+    auto Function = Mapping.Functions.begin();
+    for (const auto &Reader : Mapping.Readers) {
+        auto ReaderFilenames = Reader->getFilenamesRef();
+        for (const auto &R : Reader->getMappingRecordsRef()) {
+            auto F = ReaderFilenames.slice(R.FilenamesBegin, R.FilenamesSize);
+            FunctionFiles.clear();
+            if (Error E = readFileIndexes(R.CoverageMapping, F.size(), FunctionFiles)) {
+                return std::move(E);
+            }
+            Function->FilesBegin = uint32_t(Mapping.FileIndexesStorage.size());
+            Function->FilesSize = uint32_t(FunctionFiles.size());
+            ++Function;
+            for (uint32_t Index : FunctionFiles) {
+                auto Found = llvm::lower_bound(Mapping.Files, F[Index]);
+                Mapping.FileIndexesStorage.push_back(uint32_t(std::distance(Mapping.Files.begin(), Found)));
+            }
+        }
+    }
+    Mapping.FileIndexes = Mapping.FileIndexesStorage;
+    return std::move(Mapping);
+}
+
+// Based on BinaryCoverageReader::readNextRecord
+Error BinaryMapping::decode() {
+    // RawCoverageMappingReader expects empty vectors for each record
+    std::vector<StringRef> FunctionFilenames;
+    std::vector<CounterExpression> FunctionExpressions;
+    std::vector<CounterMappingRegion> FunctionRegions;
+
+    auto Function = Functions.begin();
+    for (const auto &Reader : Readers) {
+        auto ReaderFilenames = Reader->getFilenamesRef();
+        for (const auto &R : Reader->getMappingRecordsRef()) {
+            FunctionFilenames.clear();
+            FunctionExpressions.clear();
+            FunctionRegions.clear();
+            auto F = ReaderFilenames.slice(R.FilenamesBegin, R.FilenamesSize);
+            RawCoverageMappingReader RawReader(R.CoverageMapping, F, FunctionFilenames,
+                                               FunctionExpressions, FunctionRegions);
+            if (auto Err = RawReader.read())
+                return Err;
+
+            // Files are set by open
+            Function->ExpressionsBegin = uint32_t(ExpressionsStorage.size());
+            Function->ExpressionsSize = uint32_t(FunctionExpressions.size());
+            Function->RegionsBegin = uint32_t(RegionsStorage.size());
+            Function->RegionsSize = uint32_t(FunctionRegions.size());
+            ++Function;
+            llvm::append_range(ExpressionsStorage, FunctionExpressions);
+            llvm::append_range(RegionsStorage, FunctionRegions);
+        }
+    }
+
+    Expressions = ExpressionsStorage;
+    Regions = RegionsStorage;
+    return Error::success();
+}
@@ -0,0 +1,211 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#include "ProfileCoverage.hpp"
+
+#include <llvm19/ADT/BitVector.h>
+
+#include <algorithm>
+#include <optional>
+
+using namespace llvm19;
+using namespace llvm;
+using namespace coverage;
+
+std::vector<uint32_t> ProfileCoverage::matchedFunctions(const MappingTable &Mappings, const ProfileCounters &Profile,
+                                                        CCoverageStats *Stats)
+{
+    // Find mapping records for the executed functions only.
+    // Not executed functions and functions with mismatched hash are ignored by CoverageMapping anyway.
+    std::vector<uint32_t> Executed;
+    auto Functions = Mappings.functions();
+    Profile.forEachFunction([&](uint64_t NameHash, uint64_t FuncHash) {
+        auto Candidates = Mappings.functions(NameHash);
+        bool Matched = false;
+        for (uint32_t Index : Candidates) {
+            if (Functions[Index].Hash != FuncHash) {
+                continue;
+            }
+            Matched = true;
+            // Functions with filtered files only are never evaluated,
+            // binaries without included functions are never decoded
+            if (Mappings.isIncluded(Functions[Index])) {
+                Executed.push_back(Index);
+            }
+        }
+        // Functions of other binaries are neither matched nor mismatched
+        if (Stats && !Candidates.empty()) {
+            (Matched ? Stats->functions_matched : Stats->functions_mismatched)++;
+        }
+    });
+
+    // Keep order of the records from binaries. Duplicated records are resolved by it.
+    llvm::sort(Executed);
+    return Executed;
+}
+
+Expected<std::vector<uint32_t>> ProfileCoverage::executedFunctions(const MappingTable &Mappings,
+                                                                   const ProfileCounters &Profile,
+                                                                   CCoverageStats *Stats)
+{
+    auto Executed = matchedFunctions(Mappings, Profile, Stats);
+    // Binaries are decoded on the first profile which executes their functions
+    PhaseTimer Timer(Stats, &CCoverageStats::decode_ns);
+    if (Error E = Mappings.decode(Executed)) {
+        return std::move(E);
+    }
+    return std::move(Executed);
+}
+
+// Based on CoverageMapping::load
+Expected<ProfileCoverage> ProfileCoverage::load(const MappingTable &Mappings, const ProfileCounters &Profile,
+                                                const ProfileCounters *Baseline, CCoverageBaselineMode Mode,
+                                                CCoverageStats *Stats)
+{
+    ProfileCoverage Coverage(Mappings, Profile.hasSingleByteCoverage());
+
+    auto ExecutedOrErr = executedFunctions(Mappings, Profile, Stats);
+    if (Error E = ExecutedOrErr.takeError()) {
+        return std::move(E);
+    }
+    auto Functions = Mappings.functions();
+    for (uint32_t Index : ExecutedOrErr.get()) {
+        const auto &Function = Functions[Index];
+        auto BaselineCounts = Baseline && Mode != CCoverageBaselineModeNone
+            ? Baseline->counters(Function.NameHash, Function.Hash) : ArrayRef<uint64_t>();
+        Coverage.loadFunctionRecord(Function, Profile.counters(Function.NameHash, Function.Hash), BaselineCounts, Mode);
+    }
+    Coverage.groupRegionsByFile();
+    return std::move(Coverage);
+}
+
+// Based on CoverageMapping::loadFunctionRecord
+void ProfileCoverage::loadFunctionRecord(const FunctionMapping &Function, ArrayRef<uint64_t> Counts,
+                                         ArrayRef<uint64_t> BaselineCounts, CCoverageBaselineMode Mode)
+{
+    auto FunctionFiles = Mappings->files(Function);
+    auto MappingRegions = Mappings->regions(Function);
+
+    StringRef OrigFuncName = Function.Name;
+    if (OrigFuncName.empty() || MappingRegions.empty() || Counts.empty())
+        return;
+
+    if (FunctionFiles.empty())
+        OrigFuncName = getFuncNameWithoutPrefix(OrigFuncName);
+    else
+        OrigFuncName = getFuncNameWithoutPrefix(OrigFuncName, Mappings->files()[FunctionFiles[0]]);
+
+    CounterMappingContext Ctx(Mappings->expressions(Function));
+    Ctx.setCounts(Counts);
+
+    // [Datadog] Regions are compared with the baseline after evaluation. Counters of both profiles
+    // are consistent, their difference isn't: profile counters can be below the baseline after reset.
+    // Baseline of another function version is ignored
+    std::optional<CounterMappingContext> BaselineCtx;
+    if (BaselineCounts.size() == Counts.size()) {
+        BaselineCtx.emplace(Mappings->expressions(Function));
+        BaselineCtx->setCounts(BaselineCounts);
+    }
+    bool HasNewRegions = false;
+
+    // This coverage record is a zero region for a function that's unused in
+    // some TU, but used in a different TU. Ignore it. The coverage maps from the
+    // the used function will combine the counts from each TU.
+    if (MappingRegions.size() == 1 && MappingRegions[0].Count.isZero() && Counts[0] > 0)
+        return;
+
+    size_t RegionsBegin = Regions.size();
+    std::optional<uint64_t> ExecutionCount;
+    for (const auto &Region : MappingRegions) {
+        // MCDC decisions are not used in segments
+        if (Region.Kind == CounterMappingRegion::MCDCDecisionRegion)
+            continue;
+        Expected<int64_t> Count = Ctx.evaluate(Region.Count);
+        if (auto E = Count.takeError()) {
+            consumeError(std::move(E));
+            Regions.erase(Regions.begin() + RegionsBegin, Regions.end());
+            return;
+        }
+        Expected<int64_t> FalseCount = Ctx.evaluate(Region.FalseCount);
+        if (auto E = FalseCount.takeError()) {
+            consumeError(std::move(E));
+            Regions.erase(Regions.begin() + RegionsBegin, Regions.end());
+            return;
+        }
+        // Branch regions are not used in segments
+        if (Region.Kind == CounterMappingRegion::BranchRegion ||
+            Region.Kind == CounterMappingRegion::MCDCBranchRegion)
+            continue;
+        // [Datadog] Count is stored unsigned, negative expression results are not covered
+        int64_t RegionCount = std::max<int64_t>(*Count, 0);
+        if (!ExecutionCount)
+            ExecutionCount = RegionCount;
+        // Regions of the filtered files are skipped
+        if (!Mappings->isIncluded(FunctionFiles[Region.FileID]))
+            continue;
+        if (BaselineCtx && RegionCount > 0) {
+            Expected<int64_t> BaselineCount = BaselineCtx->evaluate(Region.Count);
+            if (!BaselineCount)
+                consumeError(BaselineCount.takeError());
+            else if (Mode == CCoverageBaselineModeSubtract)
+                RegionCount = std::max<int64_t>(RegionCount - std::max<int64_t>(*BaselineCount, 0), 0);
+            else if (*BaselineCount > 0)
+                RegionCount = 0;
+        }
+        HasNewRegions = HasNewRegions || RegionCount > 0;
+        // Region file ID is replaced with the index of the file in the MappingTable
+        Regions.emplace_back(Region, FunctionFiles[Region.FileID], RegionCount);
+    }
+
+    // [Datadog] We don't want to record not executed functions and functions without new regions
+    if (ExecutionCount.value_or(0) == 0 || (BaselineCtx && !HasNewRegions)) {
+        Regions.erase(Regions.begin() + RegionsBegin, Regions.end());
+        return;
+    }
+
+    // Don't create records for (filenames, function) pairs we've already seen.
+    // File indexes are unique for the file names, so they are hashed instead of names.
+    auto FilenamesHash = hash_combine_range(FunctionFiles.begin(), FunctionFiles.end());
+    if (!RecordProvenance[FilenamesHash].insert(hash_value(OrigFuncName)).second) {
+        Regions.erase(Regions.begin() + RegionsBegin, Regions.end());
+        return;
+    }
+
+    // Function files are touched even if they don't have regions with counts
+    for (uint32_t File : FunctionFiles)
+        if (Mappings->isIncluded(File))
+            TouchedFiles.set(File);
+}
+
+// Replacement for the FilenameHash2RecordIndices lookup of CoverageMapping::getCoverageForFile.
+// Regions are grouped by file once, so building segments of a file doesn't
+// scan function records and compare file names.
+void ProfileCoverage::groupRegionsByFile() {
+    // Files are sorted by name in the MappingTable, so set bits are sorted too
+    for (unsigned File : TouchedFiles.set_bits())
+        Files.push_back(File);
+
+    llvm::stable_sort(Regions, [](const EvaluatedRegion &LHS, const EvaluatedRegion &RHS) {
+        return LHS.FileID < RHS.FileID;
+    });
+
+    FileRegions.reserve(Files.size() + 1);
+    auto Current = Regions.begin();
+    for (uint32_t File : Files) {
+        Current = std::find_if(Current, Regions.end(), [File](const EvaluatedRegion &Region) {
+            return Region.FileID >= File;
+        });
+        FileRegions.push_back(uint32_t(std::distance(Regions.begin(), Current)));
+    }
+    FileRegions.push_back(uint32_t(Regions.size()));
+}
+
+// Based on CoverageMapping::getCoverageForFile
+std::vector<CoverageSegment> ProfileCoverage::getSegmentsForFile(size_t Position) {
+    uint32_t Begin = FileRegions[Position];
+    uint32_t End = FileRegions[Position + 1];
+    return SegmentBuilder::buildSegments(MutableArrayRef(Regions).slice(Begin, End - Begin), SingleByteCoverage);
+}
@@ -0,0 +1,70 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#pragma once
+#include "MappingTable.hpp"
+#include "ProfileCounters.hpp"
+#include "SegmentBuilder.hpp"
+#include "Stats.hpp"
+
+#include <llvm19/ADT/BitVector.h>
+#include <llvm19/ADT/DenseSet.h>
+
+namespace llvm19 {
+
+/// Coverage of the executed functions from one profile.
+/// Port of the llvm::coverage::CoverageMapping on top of the MappingTable and ProfileCounters.
+class ProfileCoverage {
+public:
+    /// Regions are evaluated with the profile and the baseline counters. Subtract mode reports the count
+    /// above the baseline count, NewRegions mode gives zero count to regions covered by the baseline.
+    /// Functions without other covered regions are skipped.
+    /// Decode time and matched functions are added to the stats if they are set
+    static llvm::Expected<ProfileCoverage> load(const MappingTable &Mappings, const ProfileCounters &Profile,
+                                                const ProfileCounters *Baseline = nullptr,
+                                                CCoverageBaselineMode Mode = CCoverageBaselineModeNone,
+                                                CCoverageStats *Stats = nullptr);
+
+    /// Indexes of the functions with counters in the profile, in the table order.
+    /// Only names and hashes are matched, binaries aren't decoded. Files of the functions can be read
+    static std::vector<uint32_t> matchedFunctions(const MappingTable &Mappings, const ProfileCounters &Profile,
+                                                  CCoverageStats *Stats = nullptr);
+
+    /// Matched functions with decoded binaries, so their regions can be read
+    static llvm::Expected<std::vector<uint32_t>> executedFunctions(const MappingTable &Mappings,
+                                                                   const ProfileCounters &Profile,
+                                                                   CCoverageStats *Stats = nullptr);
+
+    /// Files touched by executed functions, sorted by name. Values are indexes in MappingTable::files()
+    llvm::ArrayRef<uint32_t> files() const { return Files; }
+
+    /// Coverage segments for the file with provided position in files()
+    std::vector<llvm::coverage::CoverageSegment> getSegmentsForFile(size_t Position);
+
+    /// Bytes allocated for the evaluated regions
+    size_t allocatedSize() const {
+        return Regions.capacity() * sizeof(EvaluatedRegion) + FileRegions.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    const MappingTable *Mappings;
+    bool SingleByteCoverage;
+    std::vector<EvaluatedRegion> Regions;
+    llvm::DenseMap<size_t, llvm::DenseSet<size_t>> RecordProvenance;
+    llvm::BitVector TouchedFiles;
+    // Regions are grouped by file after load. Group of files[I] starts at FileRegions[I]
+    std::vector<uint32_t> Files;
+    std::vector<uint32_t> FileRegions;
+
+    ProfileCoverage(const MappingTable &Mappings, bool SingleByteCoverage):
+        Mappings(&Mappings), SingleByteCoverage(SingleByteCoverage), TouchedFiles(Mappings.files().size()) {}
+
+    void loadFunctionRecord(const FunctionMapping &Function, llvm::ArrayRef<uint64_t> Counts,
+                            llvm::ArrayRef<uint64_t> BaselineCounts, CCoverageBaselineMode Mode);
+    void groupRegionsByFile();
+};
+
+}
@@ -0,0 +1,193 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#include "SegmentBuilder.hpp"
+
+using namespace llvm19;
+using namespace llvm;
+using namespace coverage;
+
+std::vector<CoverageSegment>
+SegmentBuilder::buildSegments(MutableArrayRef<EvaluatedRegion> Regions, bool SingleByteCoverage) {
+    std::vector<CoverageSegment> Segments;
+    SegmentBuilder Builder(Segments);
+
+    sortNestedRegions(Regions);
+    ArrayRef<EvaluatedRegion> CombinedRegions = combineRegions(Regions, SingleByteCoverage);
+
+    Builder.buildSegmentsImpl(CombinedRegions);
+    return Segments;
+}
+
+/// Emit a segment with the count from Region starting at StartLoc.
+/// IsRegionEntry: The segment is at the start of a new non-gap region.
+/// EmitSkippedRegion: The segment must be emitted as a skipped region.
+void SegmentBuilder::startSegment(const EvaluatedRegion &Region, LineColPair StartLoc,
+                                  bool IsRegionEntry, bool EmitSkippedRegion)
+{
+    bool HasCount = !EmitSkippedRegion && (Region.Kind != CounterMappingRegion::SkippedRegion);
+
+    // If the new segment wouldn't affect coverage rendering, skip it.
+    if (!Segments.empty() && !IsRegionEntry && !EmitSkippedRegion) {
+        const auto &Last = Segments.back();
+        if (Last.HasCount == HasCount && Last.Count == Region.ExecutionCount && !Last.IsRegionEntry)
+            return;
+    }
+
+    if (HasCount)
+        Segments.emplace_back(StartLoc.first, StartLoc.second,
+                              Region.ExecutionCount, IsRegionEntry,
+                              Region.Kind == CounterMappingRegion::GapRegion);
+    else
+        Segments.emplace_back(StartLoc.first, StartLoc.second, IsRegionEntry);
+}
+
+/// Emit segments for active regions which end before Loc.
+/// Loc: The start location of the next region. If std::nullopt, all active regions are completed.
+/// FirstCompletedRegion: Index of the first completed region.
+void SegmentBuilder::completeRegionsUntil(std::optional<LineColPair> Loc, unsigned FirstCompletedRegion) {
+    // Sort the completed regions by end location. This makes it simple to
+    // emit closing segments in sorted order.
+    auto CompletedRegionsIt = ActiveRegions.begin() + FirstCompletedRegion;
+    std::stable_sort(CompletedRegionsIt, ActiveRegions.end(),
+                     [](const EvaluatedRegion *L, const EvaluatedRegion *R) {
+                         return L->endLoc() < R->endLoc();
+                     });
+
+    // Emit segments for all completed regions.
+    for (unsigned I = FirstCompletedRegion + 1, E = ActiveRegions.size(); I < E; ++I) {
+        const auto *CompletedRegion = ActiveRegions[I];
+        const auto *PrevCompletedRegion = ActiveRegions[I - 1];
+        auto CompletedSegmentLoc = PrevCompletedRegion->endLoc();
+
+        // Don't emit any more segments if they start where the new region begins.
+        if (Loc && CompletedSegmentLoc == *Loc)
+            break;
+
+        // Don't emit a segment if the next completed region ends at the same
+        // location as this one.
+        if (CompletedSegmentLoc == CompletedRegion->endLoc())
+            continue;
+
+        // Use the count from the last completed region which ends at this loc.
+        for (unsigned J = I + 1; J < E; ++J)
+            if (CompletedRegion->endLoc() == ActiveRegions[J]->endLoc())
+                CompletedRegion = ActiveRegions[J];
+
+        startSegment(*CompletedRegion, CompletedSegmentLoc, false);
+    }
+
+    auto Last = ActiveRegions.back();
+    if (FirstCompletedRegion && Last->endLoc() != *Loc) {
+        // If there's a gap after the end of the last completed region and the
+        // start of the new region, use the last active region to fill the gap.
+        startSegment(*ActiveRegions[FirstCompletedRegion - 1], Last->endLoc(), false);
+    } else if (!FirstCompletedRegion && (!Loc || *Loc != Last->endLoc())) {
+        // Emit a skipped segment if there are no more active regions. This
+        // ensures that gaps between functions are marked correctly.
+        startSegment(*Last, Last->endLoc(), false, true);
+    }
+
+    // Pop the completed regions.
+    ActiveRegions.erase(CompletedRegionsIt, ActiveRegions.end());
+}
+
+void SegmentBuilder::buildSegmentsImpl(ArrayRef<EvaluatedRegion> Regions) {
+    for (const auto &CR : enumerate(Regions)) {
+        auto CurStartLoc = CR.value().startLoc();
+
+        // Active regions which end before the current region need to be popped.
+        auto CompletedRegions = std::stable_partition(ActiveRegions.begin(), ActiveRegions.end(),
+                                                      [&](const EvaluatedRegion *Region) {
+                                                          return !(Region->endLoc() <= CurStartLoc);
+                                                      });
+        if (CompletedRegions != ActiveRegions.end()) {
+            unsigned FirstCompletedRegion = std::distance(ActiveRegions.begin(), CompletedRegions);
+            completeRegionsUntil(CurStartLoc, FirstCompletedRegion);
+        }
+
+        bool GapRegion = CR.value().Kind == CounterMappingRegion::GapRegion;
+
+        // Try to emit a segment for the current region.
+        if (CurStartLoc == CR.value().endLoc()) {
+            // Avoid making zero-length regions active. If it's the last region,
+            // emit a skipped segment. Otherwise use its predecessor's count.
+            const bool Skipped = (CR.index() + 1) == Regions.size() ||
+                                 CR.value().Kind == CounterMappingRegion::SkippedRegion;
+            startSegment(ActiveRegions.empty() ? CR.value() : *ActiveRegions.back(),
+                         CurStartLoc, !GapRegion, Skipped);
+            // If it is skipped segment, create a segment with last pushed
+            // regions's count at CurStartLoc.
+            if (Skipped && !ActiveRegions.empty())
+                startSegment(*ActiveRegions.back(), CurStartLoc, false);
+            continue;
+        }
+        if (CR.index() + 1 == Regions.size() || CurStartLoc != Regions[CR.index() + 1].startLoc()) {
+            // Emit a segment if the next region doesn't start at the same location
+            // as this one.
+            startSegment(CR.value(), CurStartLoc, !GapRegion);
+        }
+
+        // This region is active (i.e not completed).
+        ActiveRegions.push_back(&CR.value());
+    }
+
+    // Complete any remaining active regions.
+    if (!ActiveRegions.empty())
+        completeRegionsUntil(std::nullopt, 0);
+}
+
+/// Sort a nested sequence of regions from a single file.
+void SegmentBuilder::sortNestedRegions(MutableArrayRef<EvaluatedRegion> Regions) {
+    llvm::sort(Regions, [](const EvaluatedRegion &LHS, const EvaluatedRegion &RHS) {
+        if (LHS.startLoc() != RHS.startLoc())
+            return LHS.startLoc() < RHS.startLoc();
+        if (LHS.endLoc() != RHS.endLoc())
+            // When LHS completely contains RHS, we sort LHS first.
+            return RHS.endLoc() < LHS.endLoc();
+        // If LHS and RHS cover the same area, we need to sort them according
+        // to their kinds so that the most suitable region will become "active"
+        // in combineRegions(). Because we accumulate counter values only from
+        // regions of the same kind as the first region of the area, prefer
+        // CodeRegion to ExpansionRegion and ExpansionRegion to SkippedRegion.
+        static_assert(CounterMappingRegion::CodeRegion < CounterMappingRegion::ExpansionRegion &&
+                      CounterMappingRegion::ExpansionRegion < CounterMappingRegion::SkippedRegion,
+                      "Unexpected order of region kind values");
+        return LHS.Kind < RHS.Kind;
+    });
+}
+
+/// Combine counts of regions which cover the same area.
+ArrayRef<EvaluatedRegion> SegmentBuilder::combineRegions(MutableArrayRef<EvaluatedRegion> Regions,
+                                                       bool SingleByteCoverage)
+{
+    if (Regions.empty())
+        return Regions;
+    auto Active = Regions.begin();
+    auto End = Regions.end();
+    for (auto I = Regions.begin() + 1; I != End; ++I) {
+        if (Active->startLoc() != I->startLoc() || Active->endLoc() != I->endLoc()) {
+            // Shift to the next region.
+            ++Active;
+            if (Active != I)
+                *Active = *I;
+            continue;
+        }
+        // Merge duplicate region.
+        // If CodeRegions and ExpansionRegions cover the same area, it's probably
+        // a macro which is fully expanded to another macro. In that case, we need
+        // to accumulate counts only from CodeRegions, or else the area will be
+        // counted twice.
+        // We add counts of the regions of the same kind as the active region.
+        if (I->Kind == Active->Kind) {
+            if (SingleByteCoverage)
+                Active->ExecutionCount = Active->ExecutionCount || I->ExecutionCount;
+            else
+                Active->ExecutionCount += I->ExecutionCount;
+        }
+    }
+    return Regions.drop_back(std::distance(++Active, End));
+}
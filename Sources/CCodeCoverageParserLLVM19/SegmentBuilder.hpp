@@ -0,0 +1,62 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#pragma once
+#include <llvm19/ProfileData/Coverage/CoverageMapping.h>
+#include <optional>
+
+namespace llvm19 {
+
+/// Code region with the evaluated execution count.
+/// Simplified copy of llvm::coverage::CountedRegion
+struct EvaluatedRegion {
+    // Index of the file in the MappingTable, not the file ID of the function
+    unsigned FileID;
+    unsigned LineStart;
+    unsigned ColumnStart;
+    unsigned LineEnd;
+    unsigned ColumnEnd;
+    llvm::coverage::CounterMappingRegion::RegionKind Kind;
+    uint64_t ExecutionCount;
+
+    EvaluatedRegion(const llvm::coverage::CounterMappingRegion &R, unsigned FileID, uint64_t ExecutionCount):
+        FileID(FileID), LineStart(R.LineStart), ColumnStart(R.ColumnStart),
+        LineEnd(R.LineEnd), ColumnEnd(R.ColumnEnd), Kind(R.Kind), ExecutionCount(ExecutionCount) {}
+
+    inline llvm::coverage::LineColPair startLoc() const {
+        return llvm::coverage::LineColPair(LineStart, ColumnStart);
+    }
+
+    inline llvm::coverage::LineColPair endLoc() const {
+        return llvm::coverage::LineColPair(LineEnd, ColumnEnd);
+    }
+};
+
+/// Builds sorted list of CoverageSegments from a list of regions of one file.
+/// Copy of the SegmentBuilder from LLVM CoverageMapping.cpp
+class SegmentBuilder {
+public:
+    static std::vector<llvm::coverage::CoverageSegment>
+    buildSegments(llvm::MutableArrayRef<EvaluatedRegion> Regions, bool SingleByteCoverage);
+
+private:
+    std::vector<llvm::coverage::CoverageSegment> &Segments;
+    llvm::SmallVector<const EvaluatedRegion *, 8> ActiveRegions;
+
+    SegmentBuilder(std::vector<llvm::coverage::CoverageSegment> &Segments): Segments(Segments) {}
+
+    void startSegment(const EvaluatedRegion &Region, llvm::coverage::LineColPair StartLoc,
+                      bool IsRegionEntry, bool EmitSkippedRegion = false);
+    void completeRegionsUntil(std::optional<llvm::coverage::LineColPair> Loc,
+                              unsigned FirstCompletedRegion);
+    void buildSegmentsImpl(llvm::ArrayRef<EvaluatedRegion> Regions);
+
+    static void sortNestedRegions(llvm::MutableArrayRef<EvaluatedRegion> Regions);
+    static llvm::ArrayRef<EvaluatedRegion> combineRegions(llvm::MutableArrayRef<EvaluatedRegion> Regions,
+                                                        bool SingleByteCoverage);
+};
+
+}
@@ -0,0 +1,83 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+using namespace llvm19;
+using namespace llvm;
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        Stopping = true;
+    }
+    JobAdded.notify_all();
+    for (auto &Thread : Threads) {
+        Thread.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t Count, function_ref<void(size_t)> Body) {
+    if (Count == 0) {
+        return;
+    }
+    Job Current(Body, Count);
+
+    std::unique_lock<std::mutex> Lock(Mutex);
+    // Single item will be processed by the calling thread anyway
+    if (Count > 1) {
+        start();
+        Jobs.push_back(&Current);
+        JobAdded.notify_all();
+    }
+    // Calling thread works on its own job too
+    run(Current, Lock);
+    // Job is exhausted. Wait for the last items processed by the pool threads
+    JobFinished.wait(Lock, [&] { return Current.Workers == 0; });
+}
+
+void ThreadPool::start() {
+    if (!Threads.empty()) {
+        return;
+    }
+    // Calling thread is working too, so one thread less
+    unsigned Total = Concurrency > 0 ? Concurrency : std::max(std::thread::hardware_concurrency(), 2u);
+    unsigned Count = Total - 1;
+    Threads.reserve(Count);
+    for (unsigned I = 0; I < Count; I++) {
+        Threads.emplace_back([this] { work(); });
+    }
+}
+
+void ThreadPool::work() {
+    std::unique_lock<std::mutex> Lock(Mutex);
+    while (true) {
+        JobAdded.wait(Lock, [this] { return Stopping || !Jobs.empty(); });
+        if (Stopping) {
+            return;
+        }
+        run(*Jobs.front(), Lock);
+    }
+}
+
+void ThreadPool::run(Job &Job, std::unique_lock<std::mutex> &Lock) {
+    Job.Workers++;
+    Lock.unlock();
+    for (size_t Index = Job.Next++; Index < Job.Count; Index = Job.Next++) {
+        Job.Body(Index);
+    }
+    Lock.lock();
+    // All indexes are taken. Remove the job so idle threads pick the next one
+    auto Found = std::find(Jobs.begin(), Jobs.end(), &Job);
+    if (Found != Jobs.end()) {
+        Jobs.erase(Found);
+    }
+    if (--Job.Workers == 0) {
+        JobFinished.notify_all();
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+#pragma once
+#include <llvm19/ADT/STLFunctionalExtras.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace llvm19 {
+
+/// Pool of worker threads for the batch parsing.
+/// Threads are started on the first use and live until the pool is destroyed.
+class ThreadPool {
+public:
+    ThreadPool() = default;
+    /// Pool which runs at most Concurrency threads, including the calling one. Zero is the number of cores
+    explicit ThreadPool(unsigned Concurrency): Concurrency(Concurrency) {}
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Calls Body for every index in [0, Count) on the pool threads and the calling thread.
+    /// Idle threads take the next index of the oldest unfinished call, so slow items don't block others.
+    /// Returns when all indexes are processed. Can be called from multiple threads.
+    void parallelFor(size_t Count, llvm::function_ref<void(size_t)> Body);
+
+private:
+    struct Job {
+        llvm::function_ref<void(size_t)> Body;
+        size_t Count;
+        std::atomic<size_t> Next = 0;
+        // Threads which are processing the job. Guarded by the pool mutex
+        unsigned Workers = 0;
+
+        Job(llvm::function_ref<void(size_t)> Body, size_t Count): Body(Body), Count(Count) {}
+    };
+
+    std::mutex Mutex;
+    std::condition_variable JobAdded;
+    std::condition_variable JobFinished;
+    std::deque<Job*> Jobs;
+    std::vector<std::thread> Threads;
+    unsigned Concurrency = 0;
+    bool Stopping = false;
+
+    void start();
+    void work();
+    // Called with locked mutex. Processes indexes of the job until it's exhausted
+    void run(Job &Job, std::unique_lock<std::mutex> &Lock);
+};
+
+}
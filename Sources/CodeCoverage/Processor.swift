@@ -14,8 +14,11 @@ public struct CoverageProcessor {
     
     public var initialCoverage: CoverageInfo? { parser.initialCoverage }
     public var llvmVersion: String { parser.llvmVersion }
+    public var loadStats: ParsingStats { parser.loadStats }
     public var tempDir: URL { collector.tempDir }
     public var binaries: [CoveredBinary] { collector.binaries }
+    /// Binaries included to the last profile. Binaries without executed code are skipped
+    public var profiledBinaries: [CoveredBinary] { collector.profiledBinaries }
     
     public init(collector: CoverageCollector, parser: CoverageParser) {
         self.collector = collector
@@ -24,11 +27,14 @@ public struct CoverageProcessor {
     
     public init(for xcode: XcodeVersion,
                 temp: URL = URL(fileURLWithPath: NSTemporaryDirectory(), isDirectory: true),
-                binaries: [CoveredBinary] = .currentProcessBinaries) throws
+                binaries: [CoveredBinary] = .currentProcessBinaries,
+                mappingCache: URL? = nil,
+                fileFilter: CoverageParser.FileFilter = .all) throws
     {
         let (collector, parser) = try Self.mapError {
             let collector = try CoverageCollector(for: xcode, temp: temp, binaries: binaries)
-            return try (collector, CoverageParser(for: collector, loadInitialCoverage: true))
+            return try (collector, CoverageParser(for: collector, loadInitialCoverage: true,
+                                                  mappingCache: mappingCache, fileFilter: fileFilter))
         }
         self.init(collector: collector, parser: parser)
     }
@@ -41,10 +47,64 @@ public struct CoverageProcessor {
         try Self.mapError { try collector.stopCoverageGathering() }
     }
     
+    public func stopCoverageGatheringInMemory() throws -> Data {
+        try Self.mapError { try collector.stopCoverageGatheringInMemory() }
+    }
+    
+    public func startCoverageWindow() -> CoverageWindow {
+        collector.startCoverageWindow()
+    }
+    
+    /// Coverage of the code executed in the window so far
+    public func filesCovered(in window: CoverageWindow) throws -> CoverageInfo {
+        try Self.mapError { try parser.filesCovered(in: window.delta()) }
+    }
+    
     public func filesCovered(in profile: URL) throws -> CoverageInfo {
         try Self.mapError { try parser.filesCovered(in: profile) }
     }
     
+    public func filesCovered(in profile: Data) throws -> CoverageInfo {
+        try Self.mapError { try parser.filesCovered(in: profile) }
+    }
+    
+    /// Coverage of the profile without the code executed before the parser was created
+    public func filesCovered(in profile: URL, relativeToBaseline mode: CoverageParser.BaselineMode) throws -> CoverageInfo {
+        try Self.mapError { try parser.filesCovered(in: profile, relativeToBaseline: mode) }
+    }
+    
+    public func filesCovered(in profile: Data, relativeToBaseline mode: CoverageParser.BaselineMode) throws -> CoverageInfo {
+        try Self.mapError { try parser.filesCovered(in: profile, relativeToBaseline: mode) }
+    }
+    
+    public func filesCovered(in profile: URL, stats: inout ParsingStats) throws -> CoverageInfo {
+        try Self.mapError { try parser.filesCovered(in: profile, stats: &stats) }
+    }
+    
+    public func filesCovered(in profile: Data, stats: inout ParsingStats) throws -> CoverageInfo {
+        try Self.mapError { try parser.filesCovered(in: profile, stats: &stats) }
+    }
+    
+    public func linesCovered(in profile: URL, withCounts: Bool = false) throws -> LineCoverage {
+        try Self.mapError { try parser.linesCovered(in: profile, withCounts: withCounts) }
+    }
+    
+    public func linesCovered(in profile: Data, withCounts: Bool = false) throws -> LineCoverage {
+        try Self.mapError { try parser.linesCovered(in: profile, withCounts: withCounts) }
+    }
+    
+    public func touchedCode(in profile: URL) throws -> TouchedCode {
+        try Self.mapError { try parser.touchedCode(in: profile) }
+    }
+    
+    public func touchedCode(in profile: Data) throws -> TouchedCode {
+        try Self.mapError { try parser.touchedCode(in: profile) }
+    }
+    
+    public func filesCovered(in profiles: [URL]) -> [Result<CoverageInfo, Error>] {
+        parser.filesCovered(in: profiles).map { $0.mapError { Error.parser(error: $0) } }
+    }
+    
     public func setCoverageFile(to path: String) {
         collector.setCoverageFile(to: path)
     }
@@ -93,9 +153,15 @@ public extension XcodeVersion {
 }
 
 public extension CoverageParser {
-    convenience init(for collector: CoverageCollector, loadInitialCoverage: Bool = true) throws {
+    convenience init(for collector: CoverageCollector,
+                     loadInitialCoverage: Bool = true,
+                     mappingCache: URL? = nil,
+                     fileFilter: FileFilter = .all) throws
+    {
         try self.init(for: collector.xcode.llvmVersion,
                       binaries: collector.binaries.map(\.url),
-                      initialCodeCoverage: loadInitialCoverage ? collector.coverageFilePath : nil)
+                      initialCodeCoverage: loadInitialCoverage ? collector.coverageFilePath : nil,
+                      mappingCache: mappingCache,
+                      fileFilter: fileFilter)
     }
 }
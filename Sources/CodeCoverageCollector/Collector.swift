@@ -12,9 +12,13 @@ public final class CoverageCollector {
     public let tempDir: URL
     public let xcode: XcodeVersion
     public let binaries: [CoveredBinary]
+    /// Binaries included to the last profile returned by the stopCoverageGathering calls.
+    /// Binaries which didn't execute code since the start are skipped
+    public private(set) var profiledBinaries: [CoveredBinary] = []
     
     private var currentFileIndex: UInt64 = 0
     private let processId: Int32
+    private let snapshotPool: CoverageSnapshotPool
     
     public init(coverageFile: String, temp: URL, xcode: XcodeVersion, binaries: [CoveredBinary]) {
         let (fileName, changed, continuous) = Self.fixFileName(coverageFile: coverageFile)
@@ -23,6 +27,7 @@ public final class CoverageCollector {
         self.coverageFilePath = fileName
         self.processId = ProcessInfo.processInfo.processIdentifier
         self.tempDir = temp
+        self.snapshotPool = CoverageSnapshotPool(size: binaries.snapshotSize)
         if changed {
             if continuous {
                 binaries.disableContinuousMode()
@@ -61,11 +66,31 @@ public final class CoverageCollector {
         guard coverage.hasPrefix(tempDir.path) else {
             throw Error.coverageGatheringIsntStarted
         }
-        binaries.writeCoverage()
+        // One stream for all binaries instead of the runtime write for each of them
+        profiledBinaries = try binaries.writeCoverage(to: coverage, xcode: xcode)
         setCoverageFile(to: coverageFilePath)
         return URL(fileURLWithPath: coverage, isDirectory: false)
     }
     
+    /// Stops gathering without writing the profile to the disk.
+    /// Returns snapshot of the counters which can be parsed by the CoverageParser.
+    public func stopCoverageGatheringInMemory() throws -> Data {
+        let coverage = try Self.currentCoverageFile
+        guard coverage.hasPrefix(tempDir.path) else {
+            throw Error.coverageGatheringIsntStarted
+        }
+        let (snapshot, executed) = binaries.snapshotOfExecuted()
+        profiledBinaries = executed
+        setCoverageFile(to: coverageFilePath)
+        return snapshot
+    }
+    
+    /// Starts coverage window with a snapshot of the current counters.
+    /// Counters aren't reset, so windows can overlap and nest. Coverage file isn't changed
+    public func startCoverageWindow() -> CoverageWindow {
+        CoverageWindow(binaries: binaries, pool: snapshotPool)
+    }
+    
     public func setCoverageFile(to path: String) {
         setenv(Constants.llvmProfileFile, path, 1)
         binaries.initializeCoverageFile()
@@ -98,6 +123,8 @@ public extension CoverageCollector {
         case coverageGatheringAlreadyStarted
         case coverageGatheringIsntStarted
         case binaryBitmapCallbacksAreNil
+        case profileWriteFailed(path: String, errno: Int32)
+        case coverageWindowIsEnded
     }
 }
 
@@ -5,7 +5,11 @@
  */
 
 import Foundation
+#if canImport(MachO)
 import MachO
+#elseif canImport(Glibc)
+import Glibc
+#endif
 internal import CCodeCoverageCollector
 
 public struct CoveredBinary {
@@ -23,6 +27,7 @@ public struct CoveredBinary {
     let countersFunc: (begin: UnsafeRawPointer, end: UnsafeRawPointer)
     let dataFunc: (begin: UnsafeRawPointer, end: UnsafeRawPointer)
     let bitmapFunc: (begin: UnsafeRawPointer, end: UnsafeRawPointer)?
+    let namesFunc: (begin: UnsafeRawPointer, end: UnsafeRawPointer)?
 }
 
 public extension CoveredBinary {
@@ -44,6 +49,12 @@ public extension CoveredBinary {
         writeFileFunc()
     }
     
+    /// True if any counter isn't at the reset value, so binary executed code since the last reset.
+    /// Checks counters memory without writing the profile
+    var hasExecutedCode: Bool {
+        !coverage_counters_are_reset(profileVersion, countersFunc.begin, countersFunc.end)
+    }
+    
     func resetCounters(xcode: XcodeVersion) throws {
         switch xcode {
         case .xcode16_3, .xcode26:
@@ -61,6 +72,21 @@ public extension CoveredBinary {
         }
     }
     
+    /// Size of the counters snapshot in bytes
+    var snapshotSize: Int {
+        coverage_snapshot_size(countersFunc.begin, countersFunc.end, dataFunc.begin, dataFunc.end)
+    }
+    
+    /// Copies live counters to the buffer. Returns written size or 0 if buffer is too small
+    func snapshot(index: Int, to buffer: UnsafeMutableRawBufferPointer) -> Int {
+        guard let address = buffer.baseAddress else { return 0 }
+        return coverage_snapshot_write(profileVersion, UInt64(index),
+                                       countersFunc.begin, countersFunc.end,
+                                       dataFunc.begin, dataFunc.end,
+                                       address, buffer.count)
+    }
+    
+#if canImport(MachO)
     static var currentProcessBinaries: [CoveredBinary] {
         let numImages = _dyld_image_count()
         var binaries: [CoveredBinary] = []
@@ -70,28 +96,15 @@ public extension CoveredBinary {
                 continue
             }
             let url = URL(fileURLWithPath: String(cString: _dyld_get_image_name(i)), isDirectory: false)
-            let name = url.lastPathComponent
             let slide = _dyld_get_image_vmaddr_slide(i)
             guard slide != 0 else { continue }
             
-            if let pi = findSymbol(named: "___llvm_profile_initialize", image: header, slide: slide),
-               let wf = findSymbol(named: "___llvm_profile_write_file", image: header, slide: slide),
-               let sp = findSymbol(named: "___llvm_profile_set_page_size", image: header, slide: slide),
-               let gv = findSymbol(named: "___llvm_profile_get_version", image: header, slide: slide),
-               let bc = findSymbol(named: "___llvm_profile_begin_counters", image: header, slide: slide),
-               let ec = findSymbol(named: "___llvm_profile_end_counters", image: header, slide: slide),
-               let bd = findSymbol(named: "___llvm_profile_begin_data", image: header, slide: slide),
-               let ed = findSymbol(named: "___llvm_profile_end_data", image: header, slide: slide)
-            {
-                let bitmap = findSymbol(named: "___llvm_profile_begin_bitmap", image: header, slide: slide).flatMap { bb in
-                    findSymbol(named: "___llvm_profile_end_bitmap", image: header, slide: slide).map { eb in (bb, eb)}
-                }
-                binaries.append(CoveredBinary(name: name, url: url,
-                                              profileInitializeFileFunc: unsafeBitCast(pi, to: (@convention(c) () -> Void).self),
-                                              setPageSizeFunc: unsafeBitCast(sp, to: (@convention(c) (UInt) -> Void).self),
-                                              writeFileFunc: unsafeBitCast(wf, to: (@convention(c) () -> Void).self),
-                                              getProfileVersionFunc:  unsafeBitCast(gv, to: (@convention(c) () -> UInt64).self),
-                                              countersFunc: (bc, ec), dataFunc: (bd, ed), bitmapFunc: bitmap))
+            // Not instrumented images are skipped by the load commands check
+            var symbols = CCoverageProfileSymbols()
+            guard coverage_find_profile_symbols_in_image(header, slide, &symbols) else { continue }
+            
+            if let binary = CoveredBinary(url: url, symbols: symbols) {
+                binaries.append(binary)
             }
         }
         return binaries
@@ -103,6 +116,82 @@ public extension CoveredBinary {
     {
         coverage_find_symbol_in_image(name, header, slide)
     }
+#elseif os(Linux)
+    static var currentProcessBinaries: [CoveredBinary] {
+        var binaries: [CoveredBinary] = []
+        withUnsafeMutablePointer(to: &binaries) { binaries in
+            _ = dl_iterate_phdr({ info, _, context in
+                guard let info = info?.pointee, let phdrs = info.dlpi_phdr, let context else { return 0 }
+                let binaries = context.assumingMemoryBound(to: [CoveredBinary].self)
+                // Main executable has an empty name
+                let path = info.dlpi_name.map { String(cString: $0) }.flatMap { $0.isEmpty ? nil : $0 }
+                    ?? "/proc/self/exe"
+                
+                // Images without profile sections are skipped by the section headers check
+                var symbols = CCoverageProfileSymbols()
+                guard coverage_find_profile_symbols_in_elf_image(path, UInt(info.dlpi_addr), phdrs,
+                                                                 Int(info.dlpi_phnum), &symbols)
+                else { return 0 }
+                
+                let url = URL(fileURLWithPath: path, isDirectory: false).resolvingSymlinksInPath()
+                if let binary = CoveredBinary(url: url, symbols: symbols) {
+                    binaries.pointee.append(binary)
+                }
+                return 0
+            }, binaries)
+        }
+        return binaries
+    }
+#endif
+}
+
+extension CoveredBinary {
+    init?(url: URL, symbols: CCoverageProfileSymbols) {
+        guard let pi = symbols.initialize,
+              let wf = symbols.write_file,
+              let sp = symbols.set_page_size,
+              let gv = symbols.get_version,
+              let bc = symbols.begin_counters,
+              let ec = symbols.end_counters,
+              let bd = symbols.begin_data,
+              let ed = symbols.end_data
+        else {
+            return nil
+        }
+        let bitmap = symbols.begin_bitmap.flatMap { bb in symbols.end_bitmap.map { eb in (bb, eb) } }
+        let names = symbols.begin_names.flatMap { bn in symbols.end_names.map { en in (bn, en) } }
+        self.init(name: url.lastPathComponent, url: url,
+                  profileInitializeFileFunc: unsafeBitCast(pi, to: (@convention(c) () -> Void).self),
+                  setPageSizeFunc: unsafeBitCast(sp, to: (@convention(c) (UInt) -> Void).self),
+                  writeFileFunc: unsafeBitCast(wf, to: (@convention(c) () -> Void).self),
+                  getProfileVersionFunc:  unsafeBitCast(gv, to: (@convention(c) () -> UInt64).self),
+                  countersFunc: (bc, ec), dataFunc: (bd, ed), bitmapFunc: bitmap, namesFunc: names)
+    }
+    
+    /// Fills header and iovecs with the raw profile of the binary. iovecs should have COVERAGE_PROFILE_IOVECS capacity.
+    /// Returns count of iovecs or 0 if the profile has to be written by the LLVM runtime
+    func profile(xcode: XcodeVersion,
+                 header: UnsafeMutablePointer<CCoverageProfileHeader>,
+                 iovecs: UnsafeMutablePointer<iovec>) -> Int
+    {
+        guard let names = namesFunc else { return 0 }
+        switch xcode {
+        case .xcode16_3, .xcode26:
+            guard let bitmap = bitmapFunc else { return 0 }
+            return coverage_profile_iovecs_llvm19(profileVersion,
+                                                  countersFunc.begin, countersFunc.end,
+                                                  dataFunc.begin, dataFunc.end,
+                                                  bitmap.begin, bitmap.end,
+                                                  names.begin, names.end,
+                                                  header, iovecs)
+        case .xcode16_0:
+            return coverage_profile_iovecs_llvm17(profileVersion,
+                                                  countersFunc.begin, countersFunc.end,
+                                                  dataFunc.begin, dataFunc.end,
+                                                  names.begin, names.end,
+                                                  header, iovecs)
+        }
+    }
 }
 
 public extension Array where Element == CoveredBinary {
@@ -110,10 +199,62 @@ public extension Array where Element == CoveredBinary {
         CoveredBinary.currentProcessBinaries
     }
     
-    func writeCoverage() {
-        for binary in self {
+    /// Binaries which executed code since the last counters reset
+    var withExecutedCode: [CoveredBinary] {
+        filter { $0.hasExecutedCode }
+    }
+    
+    /// Writes profiles of the binaries which executed code. Profiles of other binaries have nothing new.
+    /// Returns written binaries
+    @discardableResult
+    func writeCoverage() -> [CoveredBinary] {
+        let executed = withExecutedCode
+        for binary in executed {
             binary.write()
         }
+        return executed
+    }
+    
+    /// Writes raw profiles of the binaries which executed code to the file with one vectored write.
+    /// Binaries which can't be serialized here (value profiling) are appended by the LLVM runtime after it.
+    /// Returns written binaries
+    @discardableResult
+    func writeCoverage(to path: String, xcode: XcodeVersion) throws -> [CoveredBinary] {
+        let executed = withExecutedCode
+        let iovecsPerBinary = Int(COVERAGE_PROFILE_IOVECS)
+        var headers = [CCoverageProfileHeader](repeating: CCoverageProfileHeader(), count: executed.count)
+        var iovecs = [iovec](repeating: iovec(), count: executed.count * iovecsPerBinary)
+        var byRuntime: [CoveredBinary] = []
+        
+        let fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0o644)
+        guard fd >= 0 else {
+            throw CoverageCollector.Error.profileWriteFailed(path: path, errno: errno)
+        }
+        // iovecs point to the headers, so both are used inside the closures
+        let error = headers.withUnsafeMutableBufferPointer { headers in
+            iovecs.withUnsafeMutableBufferPointer { iovecs in
+                // Nothing executed. Profile stays empty
+                guard let headers = headers.baseAddress, let iovecs = iovecs.baseAddress else { return 0 }
+                var count = 0
+                for (index, binary) in executed.enumerated() {
+                    let written = binary.profile(xcode: xcode, header: headers + index, iovecs: iovecs + count)
+                    if written == 0 {
+                        byRuntime.append(binary)
+                    }
+                    count += written
+                }
+                return coverage_profile_writev(fd, iovecs, count)
+            }
+        }
+        close(fd)
+        guard error == 0 else {
+            throw CoverageCollector.Error.profileWriteFailed(path: path, errno: error)
+        }
+        // Runtime appends to the LLVM_PROFILE_FILE
+        for binary in byRuntime {
+            binary.write()
+        }
+        return executed
     }
     
     func initializeCoverageFile() {
@@ -133,4 +274,60 @@ public extension Array where Element == CoveredBinary {
             try binary.resetCounters(xcode: xcode)
         }
     }
+    
+    /// Size of the counters snapshot of all binaries in bytes
+    var snapshotSize: Int {
+        reduce(0) { $0 + $1.snapshotSize }
+    }
+    
+    /// Copies live counters of all binaries to the buffer.
+    /// Returns written size or 0 if buffer is too small
+    func snapshot(to buffer: UnsafeMutableRawBufferPointer) -> Int {
+        snapshot(of: indices, to: buffer)
+    }
+    
+    /// Copies live counters of the binaries at indices to the buffer.
+    /// Returns written size or 0 if buffer is too small
+    func snapshot(of indices: some Sequence<Int>, to buffer: UnsafeMutableRawBufferPointer) -> Int {
+        var offset = 0
+        for index in indices {
+            let binary = self[index]
+            let written = binary.snapshot(index: index,
+                                          to: UnsafeMutableRawBufferPointer(rebasing: buffer[offset...]))
+            guard written > 0 else { return 0 }
+            offset += written
+        }
+        return offset
+    }
+    
+    /// Snapshot of the live counters of all binaries
+    func snapshot() -> Data {
+        snapshot(of: Array(indices))
+    }
+    
+    /// Snapshot of the live counters of the binaries which executed code since the last reset.
+    /// Returns snapshot and included binaries
+    func snapshotOfExecuted() -> (snapshot: Data, binaries: [CoveredBinary]) {
+        let executed = indices.filter { self[$0].hasExecutedCode }
+        return (snapshot(of: executed), executed.map { self[$0] })
+    }
+    
+    /// Snapshot of the live counters of the binaries at indices.
+    /// Binaries keep their index in this array in the snapshot headers
+    func snapshot(of indices: [Int]) -> Data {
+        let size = indices.reduce(0) { $0 + self[$1].snapshotSize }
+        var data = Data(count: size)
+        let written = data.withUnsafeMutableBytes { snapshot(of: indices, to: $0) }
+        // Sections are static, so the size can't change
+        precondition(written == data.count, "Coverage snapshot size mismatch")
+        return data
+    }
+}
+
+extension UnsafeMutableRawBufferPointer {
+    /// Resets memory with the counters reset kernel. Blocks which already have the value are not written
+    func resetCoverageCounters(to value: UInt8) {
+        guard let begin = baseAddress else { return }
+        coverage_reset_memory(begin, begin + count, value)
+    }
 }
@@ -0,0 +1,89 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+import Foundation
+internal import CCodeCoverageCollector
+
+/// Coverage of the code executed since the window start.
+/// Window keeps a snapshot of the counters and subtracts it from the live counters,
+/// so counters are never reset and windows can overlap and nest (suite → test → step).
+/// startCoverageGathering resets the counters: counts of an open window executed before the reset are lost,
+/// counters below the window snapshot are reported as not executed.
+public final class CoverageWindow {
+    public let binaries: [CoveredBinary]
+
+    private let pool: CoverageSnapshotPool
+    private var baseline: UnsafeMutableRawBufferPointer?
+
+    init(binaries: [CoveredBinary], pool: CoverageSnapshotPool) {
+        self.binaries = binaries
+        self.pool = pool
+        let baseline = pool.take()
+        let written = binaries.snapshot(to: baseline)
+        // Sections are static, so the size can't change
+        precondition(written == baseline.count, "Coverage snapshot size mismatch")
+        self.baseline = baseline
+    }
+
+    deinit {
+        if let baseline {
+            pool.give(baseline)
+        }
+    }
+
+    /// Snapshot with counters executed since the window start. Can be parsed by the CoverageParser.
+    /// Window stays open, so it can be called many times
+    public func delta() throws -> Data {
+        guard let baseline else {
+            throw CoverageCollector.Error.coverageWindowIsEnded
+        }
+        var snapshot = binaries.snapshot()
+        let isValid = snapshot.withUnsafeMutableBytes { live in
+            coverage_snapshot_delta(baseline.baseAddress!, live.baseAddress!, live.count)
+        }
+        precondition(isValid, "Coverage snapshot layout mismatch")
+        return snapshot
+    }
+
+    /// Returns the last delta and gives the baseline buffer back to the pool
+    public func end() throws -> Data {
+        let snapshot = try delta()
+        pool.give(baseline!)
+        baseline = nil
+        return snapshot
+    }
+}
+
+/// Snapshot buffers of the same size for the coverage windows.
+/// Buffers are reused, so windows for every test don't allocate
+final class CoverageSnapshotPool {
+    let size: Int
+
+    private let lock = NSLock()
+    private var buffers: [UnsafeMutableRawBufferPointer] = []
+
+    init(size: Int) {
+        self.size = size
+    }
+
+    deinit {
+        for buffer in buffers {
+            buffer.deallocate()
+        }
+    }
+
+    func take() -> UnsafeMutableRawBufferPointer {
+        lock.lock()
+        defer { lock.unlock() }
+        return buffers.popLast() ?? .allocate(byteCount: size, alignment: 64)
+    }
+
+    func give(_ buffer: UnsafeMutableRawBufferPointer) {
+        lock.lock()
+        defer { lock.unlock() }
+        buffers.append(buffer)
+    }
+}
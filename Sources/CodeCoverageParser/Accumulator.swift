@@ -0,0 +1,43 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+import Foundation
+internal import CCodeCoverageParser
+
+/// Sums counters of many profiles inside the parser plugin.
+/// Coverage is calculated once for all added profiles.
+/// Profiles can be added from multiple threads.
+public final class CoverageAccumulator: @unchecked Sendable {
+    public let parser: CoverageParser
+    
+    private let accumulator: CAccumulator
+    
+    internal init(parser: CoverageParser, accumulator: CAccumulator) {
+        self.parser = parser
+        self.accumulator = accumulator
+    }
+    
+    public func add(profile: URL) throws {
+        try accumulator.add(profile: profile.path).mapError(CoverageParser.Error.init).get()
+    }
+    
+    public func add(profile: Data) throws {
+        try profile.withUnsafeBytes {
+            try accumulator.add(profile: $0).mapError(CoverageParser.Error.init).get()
+        }
+    }
+    
+    /// Coverage of all profiles added so far
+    public func finalize() throws -> CoverageInfo {
+        try accumulator.finalize()
+            .mapError(CoverageParser.Error.init)
+            .map(parser.coverageInfo).get()
+    }
+    
+    deinit {
+        accumulator.destroy()
+    }
+}
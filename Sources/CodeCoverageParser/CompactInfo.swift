@@ -0,0 +1,201 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+import Foundation
+internal import CCodeCoverageParser
+
+/// Compact coverage storage for folding of many results.
+/// File is identified by its index in the sorted names. Regions of all files are stored in
+/// contiguous arrays sorted by file and location, so merge is a linear walk over both results
+/// and counts are added in place when both results have the same regions.
+public struct CompactCoverageInfo: Hashable, Equatable {
+    /// Sorted file names. Index of the name is the file ID
+    public private(set) var names: [String]
+    /// Regions of the file ID are in offsets[ID]..<offsets[ID + 1]
+    public private(set) var offsets: [Int]
+    public private(set) var locations: [CoverageInfo.Location]
+    public private(set) var counts: [UInt64]
+
+    // Dictionary based view. Built on first access and shared by the copies until mutation
+    private var view = UnfairLock<CoverageInfo?>(initialState: nil)
+
+    public init() {
+        self.names = []
+        self.offsets = [0]
+        self.locations = []
+        self.counts = []
+    }
+
+    public init(_ info: CoverageInfo) {
+        self.init()
+        for name in info.files.keys.sorted() {
+            append(name: name, regions: info.files[name]!.regions)
+        }
+    }
+
+    public var filesCount: Int { names.count }
+
+    /// File ID for the name or nil if the file isn't covered
+    public func fileID(for name: String) -> Int? {
+        let index = names.partitioningIndex { $0 >= name }
+        return index < names.count && names[index] == name ? index : nil
+    }
+
+    public func regions(of file: Int) -> Range<Int> {
+        offsets[file]..<offsets[file + 1]
+    }
+
+    public func file(_ file: Int) -> CoverageInfo.File {
+        let range = regions(of: file)
+        let regions = zip(locations[range], counts[range]).map {
+            CoverageInfo.Segment(location: $0, count: $1)
+        }
+        return CoverageInfo.File(name: names[file], sortedRegions: regions)
+    }
+
+    /// Compatibility view of the coverage. Built once and cached
+    public var info: CoverageInfo {
+        if let info = view.withLock({ $0 }) {
+            return info
+        }
+        let pairs = names.indices.map { (names[$0], file($0)) }
+        let info = CoverageInfo(files: Dictionary(uniqueKeysWithValues: pairs))
+        view.withLock { $0 = info }
+        return info
+    }
+
+    public func merged(with other: Self) -> Self {
+        var result = self
+        result.merge(with: other)
+        return result
+    }
+
+    /// Adds counts of the other coverage. Regions with the same location are summed with saturation,
+    /// other regions and files are inserted in order.
+    public mutating func merge(with other: Self) {
+        guard !other.names.isEmpty else { return }
+        view = UnfairLock(initialState: nil)
+        // Same profiled code gives the same regions. Arrays with shared storage are compared by identity
+        if names == other.names && offsets == other.offsets && locations == other.locations {
+            counts.withUnsafeMutableBufferPointer { counts in
+                other.counts.withUnsafeBufferPointer { others in
+                    for index in counts.indices {
+                        counts[index] = .saturatingSum(counts[index], others[index])
+                    }
+                }
+            }
+            return
+        }
+
+        var result = Self()
+        result.names.reserveCapacity(max(names.count, other.names.count))
+        result.offsets.reserveCapacity(max(names.count, other.names.count) + 1)
+        result.locations.reserveCapacity(max(locations.count, other.locations.count))
+        result.counts.reserveCapacity(max(counts.count, other.counts.count))
+        var lhs = 0, rhs = 0
+        while lhs < names.count || rhs < other.names.count {
+            if rhs == other.names.count || (lhs < names.count && names[lhs] < other.names[rhs]) {
+                result.append(file: lhs, of: self)
+                lhs += 1
+            } else if lhs == names.count || other.names[rhs] < names[lhs] {
+                result.append(file: rhs, of: other)
+                rhs += 1
+            } else {
+                result.mergeFile(regions(of: lhs), of: self, with: other.regions(of: rhs), of: other)
+                result.names.append(names[lhs])
+                result.offsets.append(result.locations.count)
+                lhs += 1
+                rhs += 1
+            }
+        }
+        self = result
+    }
+
+    public static func == (lhs: Self, rhs: Self) -> Bool {
+        lhs.names == rhs.names && lhs.offsets == rhs.offsets &&
+            lhs.locations == rhs.locations && lhs.counts == rhs.counts
+    }
+
+    public func hash(into hasher: inout Hasher) {
+        hasher.combine(names)
+        hasher.combine(offsets)
+        hasher.combine(locations)
+        hasher.combine(counts)
+    }
+
+    private mutating func append(name: String, regions: [CoverageInfo.Segment]) {
+        names.append(name)
+        for region in regions {
+            locations.append(region.location)
+            counts.append(region.count)
+        }
+        offsets.append(locations.count)
+    }
+
+    private mutating func append(file: Int, of info: Self) {
+        let range = info.regions(of: file)
+        names.append(info.names[file])
+        locations.append(contentsOf: info.locations[range])
+        counts.append(contentsOf: info.counts[range])
+        offsets.append(locations.count)
+    }
+
+    // Two-pointer merge of the sorted regions of one file
+    private mutating func mergeFile(_ lhsRange: Range<Int>, of lhs: Self, with rhsRange: Range<Int>, of rhs: Self) {
+        var left = lhsRange.lowerBound, right = rhsRange.lowerBound
+        while left < lhsRange.upperBound && right < rhsRange.upperBound {
+            let location = lhs.locations[left], other = rhs.locations[right]
+            if location < other {
+                locations.append(location)
+                counts.append(lhs.counts[left])
+                left += 1
+            } else if other < location {
+                locations.append(other)
+                counts.append(rhs.counts[right])
+                right += 1
+            } else {
+                locations.append(location)
+                counts.append(.saturatingSum(lhs.counts[left], rhs.counts[right]))
+                left += 1
+                right += 1
+            }
+        }
+        locations.append(contentsOf: lhs.locations[left..<lhsRange.upperBound])
+        counts.append(contentsOf: lhs.counts[left..<lhsRange.upperBound])
+        locations.append(contentsOf: rhs.locations[right..<rhsRange.upperBound])
+        counts.append(contentsOf: rhs.counts[right..<rhsRange.upperBound])
+    }
+}
+
+extension CompactCoverageInfo {
+    /// Copies region columns from C structures. Memory is owned and freed by the parser
+    internal init(cValue: CCoverageFiles) {
+        self.init()
+        // Plugin sorts names by bytes, which can differ from the String order
+        let files = Array(cValue.bufPtr)
+        let fileNames = files.map { String(cString: $0.name) }
+        let order = fileNames.indices.sorted { fileNames[$0] < fileNames[$1] }
+        let total = files.reduce(0) { $0 + $1.regions_count }
+        names.reserveCapacity(files.count)
+        offsets.reserveCapacity(files.count + 1)
+        locations.reserveCapacity(total)
+        counts.reserveCapacity(total)
+        for position in order {
+            let file = files[position]
+            names.append(fileNames[position])
+            for index in 0..<file.regions_count {
+                locations.append(CoverageInfo.Location(startLine: file.start_lines![index],
+                                                       startColumn: file.start_columns![index],
+                                                       endLine: file.end_lines![index],
+                                                       endColumn: file.end_columns![index]))
+            }
+            if file.regions_count > 0 {
+                counts.append(contentsOf: UnsafeBufferPointer(start: file.counts, count: file.regions_count))
+            }
+            offsets.append(locations.count)
+        }
+    }
+}
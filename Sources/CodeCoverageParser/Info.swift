@@ -12,7 +12,92 @@ public struct CoverageInfo: Hashable, Equatable, Codable {
     
     public struct File: Hashable, Equatable, Codable {
         public let name: String
-        public let segments: [Location: Segment]
+        /// Covered regions sorted by location. Locations are unique
+        public let regions: [Segment]
+        
+        // Dictionary based view. Built on first access and shared by the copies
+        private let view = UnfairLock<[Location: Segment]?>(initialState: nil)
+        
+        /// Covered regions by location. Built once, prefer regions for iteration and segment(at:) for lookups
+        public var segments: [Location: Segment] {
+            view.withLock { view in
+                if let view { return view }
+                let segments = Dictionary(uniqueKeysWithValues: regions.lazy.map { ($0.location, $0) })
+                view = segments
+                return segments
+            }
+        }
+        
+        /// Regions are sorted by location. The last region wins for the same location,
+        /// as with the keyed assignment to segments
+        public init(name: String, regions: [Segment]) {
+            // Strict order check catches duplicated locations too
+            if zip(regions, regions.dropFirst()).allSatisfy({ $0.location < $1.location }) {
+                self.init(name: name, sortedRegions: regions)
+                return
+            }
+            // Indexes break ties, so the later region of the same location comes last
+            let order = regions.indices.sorted { (regions[$0].location, $0) < (regions[$1].location, $1) }
+            var unique: [Segment] = []
+            unique.reserveCapacity(regions.count)
+            for index in order {
+                if let last = unique.last, last.location == regions[index].location {
+                    unique[unique.count - 1] = regions[index]
+                } else {
+                    unique.append(regions[index])
+                }
+            }
+            self.init(name: name, sortedRegions: unique)
+        }
+        
+        public init(name: String, segments: [Location: Segment]) {
+            self.init(name: name, sortedRegions: segments.values.sorted { $0.location < $1.location })
+        }
+        
+        /// Regions should be sorted by location and unique
+        internal init(name: String, sortedRegions: [Segment]) {
+            self.name = name
+            self.regions = sortedRegions
+        }
+        
+        /// Region with the location. Binary search in the sorted regions
+        public func segment(at location: Location) -> Segment? {
+            let index = regions.partitioningIndex { $0.location >= location }
+            return index < regions.count && regions[index].location == location ? regions[index] : nil
+        }
+        
+        public static func == (lhs: Self, rhs: Self) -> Bool {
+            lhs.name == rhs.name && lhs.regions == rhs.regions
+        }
+        
+        public func hash(into hasher: inout Hasher) {
+            hasher.combine(name)
+            hasher.combine(regions)
+        }
+        
+        /// Sums counts of the same locations with saturation, other regions are inserted in order
+        internal func merged(with other: Self) -> Self {
+            var result: [Segment] = []
+            result.reserveCapacity(max(regions.count, other.regions.count))
+            var left = 0, right = 0
+            while left < regions.count && right < other.regions.count {
+                let lhs = regions[left], rhs = other.regions[right]
+                if lhs.location < rhs.location {
+                    result.append(lhs)
+                    left += 1
+                } else if rhs.location < lhs.location {
+                    result.append(rhs)
+                    right += 1
+                } else {
+                    result.append(Segment(location: lhs.location, count: .saturatingSum(lhs.count, rhs.count)))
+                    left += 1
+                    right += 1
+                }
+            }
+            result.append(contentsOf: regions[left...])
+            result.append(contentsOf: other.regions[right...])
+            return File(name: name, sortedRegions: result)
+        }
     }
     
     public struct Segment: Hashable, Equatable, Codable {
@@ -20,27 +105,29 @@ public struct CoverageInfo: Hashable, Equatable, Codable {
         public let count: UInt64
     }
     
-    public struct Location: Hashable, Equatable, Codable {
+    public struct Location: Hashable, Equatable, Comparable, Codable {
         public var startLine: UInt32
         public var startColumn: UInt32
         public var endLine: UInt32
         public var endColumn: UInt32
+        
+        public static func < (lhs: Self, rhs: Self) -> Bool {
+            (lhs.startLine, lhs.startColumn, lhs.endLine, lhs.endColumn) <
+                (rhs.startLine, rhs.startColumn, rhs.endLine, rhs.endColumn)
+        }
     }
     
+    /// Counts of the same locations are summed, saturating at UInt64.max
+    /// like CompactCoverageInfo and the plugin merge
     public func merged(with other: Self) -> Self {
-        let files = self.files.merging(other.files) { (current, other) in
-            let segments = current.segments.merging(other.segments) { (current, other) in
-                Segment(location: current.location, count: current.count + other.count)
-            }
-            return File(name: current.name, segments: segments)
-        }
+        let files = self.files.merging(other.files) { $0.merged(with: $1) }
         return Self(files: files)
     }
 }
 
 extension CoverageInfo {
+    /// Copies files from C structures. Memory is owned and freed by the parser
     internal init(cValue: CCoverageFiles) {
-        defer { cValue.files?.deallocate() }
         let pairs = cValue.bufPtr.map { File(cValue: $0) }.map { ($0.name, $0) }
         self.files = Dictionary(uniqueKeysWithValues: pairs)
     }
@@ -54,58 +141,93 @@ extension CoverageInfo: CustomDebugStringConvertible {
 }
 
 extension CoverageInfo.File {
+    // Coding keys of the dictionary based format. Regions are encoded as segments dictionary
+    private enum CodingKeys: String, CodingKey {
+        case name
+        case segments
+    }
+    
+    public init(from decoder: any Decoder) throws {
+        let container = try decoder.container(keyedBy: CodingKeys.self)
+        try self.init(name: container.decode(String.self, forKey: .name),
+                      segments: container.decode([CoverageInfo.Location: CoverageInfo.Segment].self,
+                                                 forKey: .segments))
+    }
+    
+    public func encode(to encoder: any Encoder) throws {
+        var container = encoder.container(keyedBy: CodingKeys.self)
+        try container.encode(name, forKey: .name)
+        try container.encode(segments, forKey: .segments)
+    }
+    
+    /// Wraps regions built by the parser. Columns are read sequentially, regions are sorted already
     internal init(cValue: CCoverageFile) {
-        defer {
-            cValue.name.deallocate()
-            cValue.segments?.deallocate()
-        }
-        self.name = String(cString: cValue.name)
-        
-        guard cValue.segments_count > 0 else {
-            self.segments = [:]
+        let name = String(cString: cValue.name)
+        let count = cValue.regions_count
+        guard count > 0 else {
+            self.init(name: name, sortedRegions: [])
             return
         }
         
-        var segments = [CoverageInfo.Location: CoverageInfo.Segment]()
-        segments.reserveCapacity(cValue.segments_count)
-        
-        var currentLocation = CoverageInfo.Location(startLine: 0, startColumn: 0,
-                                                    endLine: 0, endColumn: 0)
-        var currentCount: UInt64 = 0
-        for segment in cValue.segmentsBufPtr {
-            switch (currentCount, segment.Count) {
-            case (0, let sc) where sc != 0: // start Boundary
-                currentLocation.startLine = segment.Line
-                currentLocation.startColumn = segment.Column
-                currentCount = segment.Count
-            case (let cc, 0) where cc != 0: // end Segment
+        let startLines = cValue.start_lines!, startColumns = cValue.start_columns!
+        let endLines = cValue.end_lines!, endColumns = cValue.end_columns!
+        let counts = cValue.counts!
+        let regions = [CoverageInfo.Segment](unsafeUninitializedCapacity: count) { buffer, initialized in
+            for index in 0..<count {
+                let location = CoverageInfo.Location(startLine: startLines[index], startColumn: startColumns[index],
+                                                     endLine: endLines[index], endColumn: endColumns[index])
+                (buffer.baseAddress! + index).initialize(to: .init(location: location, count: counts[index]))
+            }
+            initialized = count
+        }
+        self.init(name: name, sortedRegions: regions)
+    }
+}
+
+/// Builds covered regions from the LLVM coverage segments of one file for the visitor.
+/// Parser builds regions of the complete results the same way.
+/// Segment starts a region when count becomes non zero, ends it on zero and splits it on count change.
+internal struct CoverageRegionBuilder {
+    private var currentLocation = CoverageInfo.Location(startLine: 0, startColumn: 0,
+                                                        endLine: 0, endColumn: 0)
+    private var currentCount: UInt64 = 0
+    
+    /// Returns the region finished by the segment
+    mutating func add(_ segment: CCoverageSegment) -> CoverageInfo.Segment? {
+        switch (currentCount, segment.Count) {
+        case (0, let sc) where sc != 0: // start Boundary
+            currentLocation.startLine = segment.Line
+            currentLocation.startColumn = segment.Column
+            currentCount = segment.Count
+            return nil
+        case (let cc, 0) where cc != 0: // end Segment
+            currentLocation.endLine = segment.Line
+            currentLocation.endColumn = segment.Column
+            let region = CoverageInfo.Segment(location: currentLocation, count: currentCount)
+            currentLocation = .init(startLine: 0, startColumn: 0, endLine: 0, endColumn: 0)
+            currentCount = 0
+            return region
+        case (let cc, let sc) where cc != 0 && sc != 0 && sc != cc: // change Segment
+            if segment.Column > 0 {
                 currentLocation.endLine = segment.Line
+                currentLocation.endColumn = segment.Column - 1
+            } else {
+                currentLocation.endLine = segment.Line - 1
                 currentLocation.endColumn = segment.Column
-                segments[currentLocation] = .init(location: currentLocation, count: currentCount)
-                currentLocation = .init(startLine: 0, startColumn: 0, endLine: 0, endColumn: 0)
-                currentCount = 0
-            case (let cc, let sc) where cc != 0 && sc != 0 && sc != cc: // change Segment
-                if segment.Column > 0 {
-                    currentLocation.endLine = segment.Line
-                    currentLocation.endColumn = segment.Column - 1
-                } else {
-                    currentLocation.endLine = segment.Line - 1
-                    currentLocation.endColumn = segment.Column
-                }
-                segments[currentLocation] = .init(location: currentLocation, count: currentCount)
-                currentLocation = .init(startLine: segment.Line, startColumn: segment.Column,
-                                        endLine: 0, endColumn: 0)
-                currentCount = segment.Count
-            default: break
             }
+            let region = CoverageInfo.Segment(location: currentLocation, count: currentCount)
+            currentLocation = .init(startLine: segment.Line, startColumn: segment.Column,
+                                    endLine: 0, endColumn: 0)
+            currentCount = segment.Count
+            return region
+        default: return nil
         }
-        self.segments = segments
     }
 }
 
 extension CoverageInfo.File: CustomDebugStringConvertible {
     public var debugDescription: String {
-        let segments = self.segments.values
+        let segments = regions
             .map { $0.debugDescription }.joined(separator: "\n\t")
         return "\(name)\n\t\(segments)"
     }
@@ -128,9 +250,3 @@ extension CCoverageFiles {
         UnsafeBufferPointer(start: files, count: files_count)
     }
 }
-
-extension CCoverageFile {
-    var segmentsBufPtr: UnsafeBufferPointer<CCoverageSegment> {
-        UnsafeBufferPointer(start: segments, count: segments_count)
-    }
-}
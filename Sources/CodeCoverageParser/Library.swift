@@ -8,6 +8,7 @@ import Foundation
 internal import CCodeCoverageParser
 
 internal typealias CParser = UnsafePointer<CCoverageParser>
+internal typealias CAccumulator = UnsafeMutablePointer<CCoverageAccumulator>
 
 public enum LLVMVersion: UInt8, Hashable, Equatable {
     case llvm17 = 17
@@ -43,8 +44,11 @@ final class CoverageParserLibrary {
         instance.llvmVersion
     }
     
-    func createCoverageProcessor(binaries: [String]) -> Result<CParser, Error> {
-        instance.createProcessor(binaries: binaries)
+    func createCoverageProcessor(binaries: [String], mappingCache: String?,
+                                 fileFilter: CoverageParser.FileFilter,
+                                 stats: inout CCoverageStats) -> Result<CParser, Error>
+    {
+        instance.createProcessor(binaries: binaries, mappingCache: mappingCache, fileFilter: fileFilter, stats: &stats)
     }
     
     static func library(for llvm: LLVMVersion) -> Result<CoverageParserLibrary, Error> {
@@ -88,9 +92,22 @@ extension UnsafePointer where Pointee == CCoverageParserLibrary {
         String(cString: pointee.llvm_version)
     }
     
-    func createProcessor(binaries: [String]) -> Result<CParser, CoverageParserLibrary.Error> {
-        let result = binaries.withCStringsArray {
-            pointee.create_parser($0, UInt32($0.count))
+    func createProcessor(binaries: [String], mappingCache: String?,
+                         fileFilter: CoverageParser.FileFilter,
+                         stats: UnsafeMutablePointer<CCoverageStats>) -> Result<CParser, CoverageParserLibrary.Error>
+    {
+        let result = binaries.withCStringsArray { binaries in
+            mappingCache.withOptionalCString { cache in
+                fileFilter.include.withCStringsArray { include in
+                    fileFilter.exclude.withCStringsArray { exclude in
+                        var options = CCoverageParserOptions(cache_directory: cache,
+                                                             include_files: include, include_files_count: include.count,
+                                                             exclude_files: exclude, exclude_files_count: exclude.count,
+                                                             stats: stats)
+                        return pointee.create_parser_with_options(binaries, UInt32(binaries.count), &options)
+                    }
+                }
+            }
         }
         if result.is_error {
             // Crash on empty error string. If is_error is set to true an error string should be set too.
@@ -104,19 +121,233 @@ extension UnsafePointer where Pointee == CCoverageParserLibrary {
 
 extension UnsafePointer where Pointee == CCoverageParser {
     func filesCovered(in profilePath: String) -> Result<CCoverageFiles, CoverageParserLibrary.Error> {
-        let result = pointee.covered_files(self, profilePath)
-        if result.is_error {
-            // Crash on empty error string. If is_error is set to true an error string should be set too.
-            // It's more for development of C++ part
-            defer { result.error!.deallocate() }
-            return .failure(.plugin(error: String(cString: result.error!)))
+        pointee.covered_files(self, profilePath).result
+    }
+    
+    func filesCovered(in profile: UnsafeRawBufferPointer) -> Result<CCoverageFiles, CoverageParserLibrary.Error> {
+        // empty profile is an error anyway, pointer should be non null
+        pointee.covered_files_in_buffer(self, profile.baseAddress ?? UnsafeRawPointer(bitPattern: 1)!, profile.count).result
+    }
+    
+    func filesCovered(in profilePath: String,
+                      stats: inout CCoverageStats) -> Result<CCoverageFiles, CoverageParserLibrary.Error>
+    {
+        pointee.covered_files_with_stats(self, profilePath, &stats).result
+    }
+    
+    func filesCovered(in profile: UnsafeRawBufferPointer,
+                      stats: inout CCoverageStats) -> Result<CCoverageFiles, CoverageParserLibrary.Error>
+    {
+        // empty profile is an error anyway, pointer should be non null
+        pointee.covered_files_in_buffer_with_stats(self, profile.baseAddress ?? UnsafeRawPointer(bitPattern: 1)!,
+                                                   profile.count, &stats).result
+    }
+    
+    /// Callback is called from the plugin threads as soon as the profile is parsed
+    func filesCovered(in profilePaths: [String],
+                      _ callback: (Int, Result<CCoverageFiles, CoverageParserLibrary.Error>) -> Void)
+    {
+        typealias Callback = (Int, Result<CCoverageFiles, CoverageParserLibrary.Error>) -> Void
+        withoutActuallyEscaping(callback) { callback in
+            var callback: Callback = callback
+            withUnsafeMutablePointer(to: &callback) { context in
+                profilePaths.withCStringsArray { paths in
+                    pointee.covered_files_batch(self, paths, paths.count, context) { context, index, result in
+                        let callback = context!.assumingMemoryBound(to: Callback.self).pointee
+                        callback(index, result.result)
+                    }
+                }
+            }
+        }
+    }
+    
+    func setBaseline(profile profilePath: String) -> Result<Void, CoverageParserLibrary.Error> {
+        Self.result(of: pointee.set_baseline(self, profilePath))
+    }
+    
+    /// Empty profile resets the baseline
+    func setBaseline(profile data: UnsafeRawBufferPointer) -> Result<Void, CoverageParserLibrary.Error> {
+        Self.result(of: pointee.set_baseline_in_buffer(self, data.baseAddress, data.count))
+    }
+    
+    func filesCovered(in profilePath: String,
+                      relativeTo mode: CCoverageBaselineMode) -> Result<CCoverageFiles, CoverageParserLibrary.Error>
+    {
+        pointee.covered_files_relative(self, profilePath, mode).result
+    }
+    
+    func filesCovered(in profile: UnsafeRawBufferPointer,
+                      relativeTo mode: CCoverageBaselineMode) -> Result<CCoverageFiles, CoverageParserLibrary.Error>
+    {
+        // empty profile is an error anyway, pointer should be non null
+        pointee.covered_files_in_buffer_relative(self, profile.baseAddress ?? UnsafeRawPointer(bitPattern: 1)!,
+                                                 profile.count, mode).result
+    }
+    
+    func linesCovered(in profilePath: String,
+                      withCounts: Bool) -> Result<CCoverageLines, CoverageParserLibrary.Error>
+    {
+        pointee.covered_lines(self, profilePath, withCounts).result
+    }
+    
+    func linesCovered(in profile: UnsafeRawBufferPointer,
+                      withCounts: Bool) -> Result<CCoverageLines, CoverageParserLibrary.Error>
+    {
+        // empty profile is an error anyway, pointer should be non null
+        pointee.covered_lines_in_buffer(self, profile.baseAddress ?? UnsafeRawPointer(bitPattern: 1)!,
+                                        profile.count, withCounts).result
+    }
+    
+    func freeLines(_ lines: CCoverageLines) {
+        pointee.free_lines_result(self, lines)
+    }
+    
+    func touchedCode(in profilePath: String) -> Result<CCoverageTouched, CoverageParserLibrary.Error> {
+        pointee.touched_files(self, profilePath).result
+    }
+    
+    func touchedCode(in profile: UnsafeRawBufferPointer) -> Result<CCoverageTouched, CoverageParserLibrary.Error> {
+        // empty profile is an error anyway, pointer should be non null
+        pointee.touched_files_in_buffer(self, profile.baseAddress ?? UnsafeRawPointer(bitPattern: 1)!,
+                                        profile.count).result
+    }
+    
+    func freeTouched(_ touched: CCoverageTouched) {
+        pointee.free_touched_result(self, touched)
+    }
+    
+    /// Visitor callbacks are called on the calling thread
+    func visitFilesCovered(in profilePath: String,
+                           _ context: inout VisitorContext) -> Result<Void, CoverageParserLibrary.Error>
+    {
+        Self.withVisitor(&context) { pointee.visit_covered_files(self, profilePath, $0) }
+    }
+    
+    func visitFilesCovered(in profile: UnsafeRawBufferPointer,
+                           _ context: inout VisitorContext) -> Result<Void, CoverageParserLibrary.Error>
+    {
+        // empty profile is an error anyway, pointer should be non null
+        Self.withVisitor(&context) {
+            pointee.visit_covered_files_in_buffer(self, profile.baseAddress ?? UnsafeRawPointer(bitPattern: 1)!,
+                                                  profile.count, $0)
         }
-        return .success(result.files)
+    }
+    
+    /// Files are merged in parallel on the plugin threads. Results stay owned by the caller
+    func merge(_ results: [CCoverageFiles]) -> CCoverageFiles {
+        results.withUnsafeBufferPointer {
+            // empty array can have nil base address, pointer should be non null
+            pointee.merge_results(self, $0.baseAddress ?? UnsafePointer(bitPattern: MemoryLayout<CCoverageFiles>.alignment)!,
+                                  $0.count)
+        }
+    }
+    
+    func freeResult(_ files: CCoverageFiles) {
+        pointee.free_result(self, files)
+    }
+    
+    func createAccumulator() -> CAccumulator {
+        pointee.create_accumulator(self)
     }
     
     consuming func destroy() {
         pointee.destroy(UnsafeMutablePointer(mutating: self))
     }
+    
+    private static func withVisitor(_ context: inout VisitorContext,
+                                    _ body: (UnsafePointer<CCoverageVisitor>) -> UnsafePointer<CChar>?)
+        -> Result<Void, CoverageParserLibrary.Error>
+    {
+        let error = withUnsafeMutablePointer(to: &context) { context in
+            var visitor = CCoverageVisitor(
+                context: UnsafeMutableRawPointer(context),
+                begin_file: { context, name, length in
+                    let context = context!.assumingMemoryBound(to: VisitorContext.self)
+                    context.pointee.regions = CoverageRegionBuilder()
+                    context.pointee.beginFile(String(decoding: UnsafeRawBufferPointer(start: name, count: length),
+                                                     as: UTF8.self))
+                },
+                segments: { context, segments, count in
+                    let context = context!.assumingMemoryBound(to: VisitorContext.self)
+                    for segment in UnsafeBufferPointer(start: segments, count: count) {
+                        if let region = context.pointee.regions.add(segment) {
+                            context.pointee.visitSegment(region)
+                        }
+                    }
+                },
+                end_file: { context in
+                    context!.assumingMemoryBound(to: VisitorContext.self).pointee.endFile()
+                }
+            )
+            return body(&visitor)
+        }
+        guard let error else { return .success(()) }
+        defer { error.deallocate() }
+        return .failure(.plugin(error: String(cString: error)))
+    }
+    
+    private static func result(of error: UnsafePointer<CChar>?) -> Result<Void, CoverageParserLibrary.Error> {
+        guard let error else { return .success(()) }
+        defer { error.deallocate() }
+        return .failure(.plugin(error: String(cString: error)))
+    }
+}
+
+extension UnsafeMutablePointer where Pointee == CCoverageAccumulator {
+    func add(profile profilePath: String) -> Result<Void, CoverageParserLibrary.Error> {
+        Self.result(of: pointee.add_file(self, profilePath))
+    }
+    
+    func add(profile data: UnsafeRawBufferPointer) -> Result<Void, CoverageParserLibrary.Error> {
+        // empty profile is an error anyway, pointer should be non null
+        Self.result(of: pointee.add_buffer(self, data.baseAddress ?? UnsafeRawPointer(bitPattern: 1)!, data.count))
+    }
+    
+    func finalize() -> Result<CCoverageFiles, CoverageParserLibrary.Error> {
+        pointee.finalize(self).result
+    }
+    
+    consuming func destroy() {
+        pointee.destroy(self)
+    }
+    
+    private static func result(of error: UnsafePointer<CChar>?) -> Result<Void, CoverageParserLibrary.Error> {
+        guard let error else { return .success(()) }
+        defer { error.deallocate() }
+        return .failure(.plugin(error: String(cString: error)))
+    }
+}
+
+private extension CCoverageFilesResult {
+    var result: Result<CCoverageFiles, CoverageParserLibrary.Error> {
+        if is_error {
+            // Crash on empty error string. If is_error is set to true an error string should be set too.
+            // It's more for development of C++ part
+            defer { error!.deallocate() }
+            return .failure(.plugin(error: String(cString: error!)))
+        }
+        return .success(files)
+    }
+}
+
+private extension CCoverageLinesResult {
+    var result: Result<CCoverageLines, CoverageParserLibrary.Error> {
+        if is_error {
+            defer { error!.deallocate() }
+            return .failure(.plugin(error: String(cString: error!)))
+        }
+        return .success(lines)
+    }
+}
+
+private extension CCoverageTouchedResult {
+    var result: Result<CCoverageTouched, CoverageParserLibrary.Error> {
+        if is_error {
+            defer { error!.deallocate() }
+            return .failure(.plugin(error: String(cString: error!)))
+        }
+        return .success(touched)
+    }
 }
 
 private extension LLVMVersion {
@@ -0,0 +1,91 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+import Foundation
+internal import CCodeCoverageParser
+
+/// Line coverage of the files, calculated by the parser the same way as `llvm-cov` does.
+/// Lines are packed into bitsets, so coverage of many profiles is merged by words.
+public struct LineCoverage: Hashable, Equatable, Codable {
+    public let files: [String: File]
+    
+    public struct File: Hashable, Equatable, Codable {
+        public let name: String
+        /// Last coverable line
+        public let linesCount: Int
+        /// Lines with code. Line N is bit (N - 1) % 64 of word (N - 1) / 64
+        public let coverable: [UInt64]
+        /// Executed lines. Same layout as coverable
+        public let covered: [UInt64]
+        /// Execution counts of the lines. Element N - 1 is for line N. Empty if counts weren't requested
+        public let counts: [UInt64]
+        
+        public func isCoverable(line: Int) -> Bool {
+            Self.bit(of: line, in: coverable)
+        }
+        
+        public func isCovered(line: Int) -> Bool {
+            Self.bit(of: line, in: covered)
+        }
+        
+        /// Bitsets are OR-ed and counts are added, saturating at the max value. Counts are kept only if both files have them
+        public func merged(with other: Self) -> Self {
+            let hasCounts = !counts.isEmpty && !other.counts.isEmpty
+            return File(name: name,
+                        linesCount: max(linesCount, other.linesCount),
+                        coverable: Self.merge(coverable, other.coverable, |),
+                        covered: Self.merge(covered, other.covered, |),
+                        counts: hasCounts ? Self.merge(counts, other.counts, UInt64.saturatingSum) : [])
+        }
+        
+        private static func bit(of line: Int, in bitset: [UInt64]) -> Bool {
+            let index = line - 1
+            guard index >= 0, index / 64 < bitset.count else { return false }
+            return bitset[index / 64] & (1 << UInt64(index % 64)) != 0
+        }
+        
+        // Element-wise operation on arrays of different size. Missing elements are zero.
+        // Simple loop over contiguous memory, so it's vectorized by the compiler
+        private static func merge(_ lhs: [UInt64], _ rhs: [UInt64],
+                                  _ operation: (UInt64, UInt64) -> UInt64) -> [UInt64]
+        {
+            let (long, short) = lhs.count >= rhs.count ? (lhs, rhs) : (rhs, lhs)
+            var result = long
+            result.withUnsafeMutableBufferPointer { result in
+                short.withUnsafeBufferPointer { short in
+                    for index in 0..<short.count {
+                        result[index] = operation(result[index], short[index])
+                    }
+                }
+            }
+            return result
+        }
+    }
+    
+    public func merged(with other: Self) -> Self {
+        Self(files: files.merging(other.files) { $0.merged(with: $1) })
+    }
+}
+
+extension LineCoverage {
+    /// Copies files from C structures. Memory is owned and freed by the parser
+    internal init(cValue: CCoverageLines) {
+        let files = UnsafeBufferPointer(start: cValue.files, count: cValue.files_count)
+        self.files = Dictionary(uniqueKeysWithValues: files.map { File(cValue: $0) }.map { ($0.name, $0) })
+    }
+}
+
+extension LineCoverage.File {
+    internal init(cValue: CCoverageFileLines) {
+        let lines = Int(cValue.lines_count)
+        let words = (lines + 63) / 64
+        self.name = String(cString: cValue.name)
+        self.linesCount = lines
+        self.coverable = Array(UnsafeBufferPointer(start: cValue.coverable, count: words))
+        self.covered = Array(UnsafeBufferPointer(start: cValue.covered, count: words))
+        self.counts = cValue.counts.map { Array(UnsafeBufferPointer(start: $0, count: lines)) } ?? []
+    }
+}
@@ -10,14 +10,22 @@ internal import CCodeCoverageParser
 public final class CoverageParser {
     public let binaries: [URL]
     public private(set) var initialCoverage: CoverageInfo? = nil
+    /// Load time of the binaries on the parser creation
+    public let loadStats: ParsingStats
     public var llvmVersion: String { library.llvmVersion }
     
     private let library: CoverageParserLibrary
     private let processor: CParser
     
-    private init(library: CoverageParserLibrary, binaries: [URL], initialCodeCoverage: String?) throws {
+    private init(library: CoverageParserLibrary, binaries: [URL],
+                 initialCodeCoverage: String?, mappingCache: URL?, fileFilter: FileFilter) throws
+    {
         let binariesPath = binaries.map { $0.path }
-        let processor = try library.createCoverageProcessor(binaries: binariesPath).mapError {
+        var loadStats = CCoverageStats()
+        let processor = try library.createCoverageProcessor(binaries: binariesPath,
+                                                            mappingCache: mappingCache?.path,
+                                                            fileFilter: fileFilter,
+                                                            stats: &loadStats).mapError {
             switch $0 {
             case .plugin(error: let err): return Error.processorInitFailed(error: err)
             default: return Error(from: $0)
@@ -26,25 +34,209 @@ public final class CoverageParser {
         self.library = library
         self.binaries = binaries
         self.processor = processor
+        self.loadStats = ParsingStats(cValue: loadStats)
         if let path = initialCodeCoverage,
            let file = Self.initialCoverageFileURL(coverageFilePath: path)
         {
-            self.initialCoverage = try filesCovered(in: file)
+            // Profile is read once for the coverage and the baseline
+            let profile = try Data(contentsOf: file, options: .mappedIfSafe)
+            self.initialCoverage = try filesCovered(in: profile)
+            // Code executed before the tests is the natural baseline of the relative coverage.
+            // Parser without the baseline computes full coverage, so it's not an error for the creation
+            try? setBaseline(profile: profile)
         }
     }
     
+    /// Decoded coverage mappings are saved to the mappingCache directory if it's set,
+    /// so next runs for the same binaries skip decoding.
+    /// Files rejected by the fileFilter are never reported, functions only in them are never evaluated
+    /// and binaries without other files are never decoded
     public convenience init(for llvm: LLVMVersion,
                             binaries: [URL],
-                            initialCodeCoverage: String? = nil) throws
+                            initialCodeCoverage: String? = nil,
+                            mappingCache: URL? = nil,
+                            fileFilter: FileFilter = .all) throws
     {
         let library = try CoverageParserLibrary.library(for: llvm).mapError(Error.init).get()
-        try self.init(library: library, binaries: binaries, initialCodeCoverage: initialCodeCoverage)
+        try self.init(library: library, binaries: binaries, initialCodeCoverage: initialCodeCoverage,
+                      mappingCache: mappingCache, fileFilter: fileFilter)
     }
     
     public func filesCovered(in profile: URL) throws -> CoverageInfo {
         try processor.filesCovered(in: profile.path)
             .mapError(Error.init)
-            .map { CoverageInfo(cValue: $0) }.get()
+            .map(coverageInfo).get()
+    }
+    
+    /// Parses profile in memory: raw profile or counters snapshot from the CoverageCollector
+    public func filesCovered(in profile: Data) throws -> CoverageInfo {
+        try profile.withUnsafeBytes { processor.filesCovered(in: $0) }
+            .mapError(Error.init)
+            .map(coverageInfo).get()
+    }
+    
+    /// Sets the profile which relative coverage is computed against. Replaces the previous baseline.
+    /// Parser created with the initial coverage uses it as the baseline if it can be set
+    public func setBaseline(profile: URL) throws {
+        try processor.setBaseline(profile: profile.path).mapError(Error.init).get()
+    }
+    
+    /// Sets the baseline from the profile in memory. Empty data resets the baseline
+    public func setBaseline(profile: Data) throws {
+        try profile.withUnsafeBytes { processor.setBaseline(profile: $0) }.mapError(Error.init).get()
+    }
+    
+    /// Coverage of the profile without the baseline part. Full coverage if the baseline isn't set
+    public func filesCovered(in profile: URL, relativeToBaseline mode: BaselineMode) throws -> CoverageInfo {
+        try processor.filesCovered(in: profile.path, relativeTo: mode.cValue)
+            .mapError(Error.init)
+            .map(coverageInfo).get()
+    }
+    
+    /// Coverage of the profile in memory without the baseline part
+    public func filesCovered(in profile: Data, relativeToBaseline mode: BaselineMode) throws -> CoverageInfo {
+        try profile.withUnsafeBytes { processor.filesCovered(in: $0, relativeTo: mode.cValue) }
+            .mapError(Error.init)
+            .map(coverageInfo).get()
+    }
+    
+    /// Parses profile and adds counters of the parsing phases to the stats
+    public func filesCovered(in profile: URL, stats: inout ParsingStats) throws -> CoverageInfo {
+        var cStats = stats.cValue
+        defer { stats = ParsingStats(cValue: cStats) }
+        return try processor.filesCovered(in: profile.path, stats: &cStats)
+            .mapError(Error.init)
+            .map(coverageInfo).get()
+    }
+    
+    /// Parses profile in memory and adds counters of the parsing phases to the stats
+    public func filesCovered(in profile: Data, stats: inout ParsingStats) throws -> CoverageInfo {
+        var cStats = stats.cValue
+        defer { stats = ParsingStats(cValue: cStats) }
+        return try profile.withUnsafeBytes { processor.filesCovered(in: $0, stats: &cStats) }
+            .mapError(Error.init)
+            .map(coverageInfo).get()
+    }
+    
+    /// Coverage of the profile in the compact form, for folding of many results
+    public func compactFilesCovered(in profile: URL) throws -> CompactCoverageInfo {
+        try processor.filesCovered(in: profile.path)
+            .mapError(Error.init)
+            .map(compactCoverageInfo).get()
+    }
+    
+    /// Coverage of the profile in memory in the compact form
+    public func compactFilesCovered(in profile: Data) throws -> CompactCoverageInfo {
+        try profile.withUnsafeBytes { processor.filesCovered(in: $0) }
+            .mapError(Error.init)
+            .map(compactCoverageInfo).get()
+    }
+    
+    /// Parses profiles in parallel on the parser threads.
+    /// Callback is called concurrently with the index of the profile as soon as it's parsed.
+    public func filesCovered(in profiles: [URL], _ callback: (Int, Result<CoverageInfo, Error>) -> Void) {
+        processor.filesCovered(in: profiles.map { $0.path }) { index, result in
+            callback(index, result.mapError(Error.init).map(coverageInfo))
+        }
+    }
+    
+    /// Parses profiles in parallel on the parser threads. Results are in the order of profiles.
+    public func filesCovered(in profiles: [URL]) -> [Result<CoverageInfo, Error>] {
+        let results = UnfairLock<[Result<CoverageInfo, Error>?]>(initialState: Array(repeating: nil, count: profiles.count))
+        filesCovered(in: profiles) { index, result in
+            results.withLock { $0[index] = result }
+        }
+        return results.withLock { $0.map { $0! } }
+    }
+    
+    /// Parses profiles in parallel and merges their coverage in the plugin, file by file on all cores.
+    /// Same result as folding with CoverageInfo.merged, but much faster: regions with the same location
+    /// are summed, other regions are kept, so regions of different profiles may overlap
+    public func mergedFilesCovered(in profiles: [URL]) throws -> CoverageInfo {
+        typealias Parsed = Result<CCoverageFiles, CoverageParserLibrary.Error>
+        let results = UnfairLock<[Parsed?]>(initialState: Array(repeating: nil, count: profiles.count))
+        processor.filesCovered(in: profiles.map { $0.path }) { index, result in
+            results.withLock { $0[index] = result }
+        }
+        let parsed = results.withLock { $0.map { $0! } }
+        defer {
+            for case .success(let files) in parsed {
+                processor.freeResult(files)
+            }
+        }
+        let files = try parsed.map { try $0.mapError(Error.init).get() }
+        return coverageInfo(from: processor.merge(files))
+    }
+    
+    /// Line coverage of the profile. Line counts are returned only if requested
+    public func linesCovered(in profile: URL, withCounts: Bool = false) throws -> LineCoverage {
+        try processor.linesCovered(in: profile.path, withCounts: withCounts)
+            .mapError(Error.init)
+            .map(lineCoverage).get()
+    }
+    
+    /// Line coverage of the profile in memory: raw profile or counters snapshot from the CoverageCollector
+    public func linesCovered(in profile: Data, withCounts: Bool = false) throws -> LineCoverage {
+        try profile.withUnsafeBytes { processor.linesCovered(in: $0, withCounts: withCounts) }
+            .mapError(Error.init)
+            .map(lineCoverage).get()
+    }
+    
+    /// Files and functions with executed code. Mappings aren't decoded, so it's much faster than filesCovered
+    public func touchedCode(in profile: URL) throws -> TouchedCode {
+        try processor.touchedCode(in: profile.path)
+            .mapError(Error.init)
+            .map(touchedCode).get()
+    }
+    
+    /// Files and functions with executed code in the profile in memory
+    public func touchedCode(in profile: Data) throws -> TouchedCode {
+        try profile.withUnsafeBytes { processor.touchedCode(in: $0) }
+            .mapError(Error.init)
+            .map(touchedCode).get()
+    }
+    
+    /// Parses profile and streams covered files to the visitor on the calling thread.
+    /// Only segments of one file are kept in memory
+    public func visitFilesCovered<V: CoverageVisitor>(in profile: URL, visitor: inout V) throws {
+        try VisitorContext.with(&visitor) { processor.visitFilesCovered(in: profile.path, &$0) }
+            .mapError(Error.init).get()
+    }
+    
+    /// Parses profile in memory and streams covered files to the visitor on the calling thread
+    public func visitFilesCovered<V: CoverageVisitor>(in profile: Data, visitor: inout V) throws {
+        try profile.withUnsafeBytes { profile in
+            VisitorContext.with(&visitor) { processor.visitFilesCovered(in: profile, &$0) }
+        }.mapError(Error.init).get()
+    }
+    
+    /// Creates accumulator for summing of many profiles into one coverage
+    public func makeAccumulator() -> CoverageAccumulator {
+        CoverageAccumulator(parser: self, accumulator: processor.createAccumulator())
+    }
+    
+    /// Converts plugin result to the CoverageInfo and frees it
+    internal func coverageInfo(from files: CCoverageFiles) -> CoverageInfo {
+        defer { processor.freeResult(files) }
+        return CoverageInfo(cValue: files)
+    }
+    
+    /// Converts plugin result to the CompactCoverageInfo and frees it
+    internal func compactCoverageInfo(from files: CCoverageFiles) -> CompactCoverageInfo {
+        defer { processor.freeResult(files) }
+        return CompactCoverageInfo(cValue: files)
+    }
+    
+    /// Converts plugin result to the TouchedCode and frees it
+    internal func touchedCode(from touched: CCoverageTouched) -> TouchedCode {
+        defer { processor.freeTouched(touched) }
+        return TouchedCode(cValue: touched)
+    }
+    
+    /// Converts plugin result to the LineCoverage and frees it
+    internal func lineCoverage(from lines: CCoverageLines) -> LineCoverage {
+        defer { processor.freeLines(lines) }
+        return LineCoverage(cValue: lines)
     }
     
     deinit {
@@ -71,6 +263,43 @@ public final class CoverageParser {
 }
 
 public extension CoverageParser {
+    /// Source files filter. File is reported if it matches any include pattern
+    /// (or include is empty) and doesn't match exclude patterns.
+    ///
+    /// Pattern syntax:
+    /// - Pattern with glob characters (`*`, `?`, `[`, `{`) is a glob matched against the whole path.
+    ///   `*` matches any characters including `/`, `[a-z]` and `{a,b}` are character classes and alternatives.
+    ///   Invalid glob fails the parser creation.
+    /// - Other patterns are path prefixes matched at the path component boundary: `/src/App` and `/src/App/`
+    ///   match `/src/App/main.swift`, but `/src/App` doesn't match `/src/AppTests/main.swift`.
+    struct FileFilter: Hashable, Equatable, Sendable {
+        public var include: [String]
+        public var exclude: [String]
+        
+        public init(include: [String] = [], exclude: [String] = []) {
+            self.include = include
+            self.exclude = exclude
+        }
+        
+        public static let all = FileFilter()
+    }
+    
+    /// How the baseline profile is removed from the coverage
+    enum BaselineMode: Hashable, Equatable, Sendable {
+        /// Region count is its count above the baseline count of the region.
+        /// Regions executed no more times than in the baseline aren't covered
+        case subtractCounts
+        /// Only regions not covered in the baseline. Counts stay as in the profile
+        case newRegions
+        
+        internal var cValue: CCoverageBaselineMode {
+            switch self {
+            case .subtractCounts: return CCoverageBaselineModeSubtract
+            case .newRegions: return CCoverageBaselineModeNewRegions
+            }
+        }
+    }
+    
     enum Error: Swift.Error {
         case dlopenFailed(path: String)
         case pluginsDirIsNil(bundle: Bundle)
@@ -0,0 +1,59 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+import Foundation
+internal import CCodeCoverageParser
+
+/// Counters of the parsing phases. Collecting them costs a few clock reads per parse.
+/// Times are in nanoseconds. Parser adds counters to the passed value, so one value can sum many parses.
+public struct ParsingStats: Hashable, Equatable, Codable, Sendable {
+    /// Binaries load on the parser creation
+    public var loadTime: UInt64 = 0
+    /// Decode of the mapping regions of binaries executed for the first time
+    public var decodeTime: UInt64 = 0
+    public var readProfileTime: UInt64 = 0
+    /// Evaluation of the mapping regions with counters. Includes decodeTime
+    public var mappingTime: UInt64 = 0
+    public var segmentsTime: UInt64 = 0
+    /// Conversion of the regions to the plugin result
+    public var conversionTime: UInt64 = 0
+    /// Functions with counters in the profile
+    public var recordsRead: UInt64 = 0
+    public var functionsMatched: UInt64 = 0
+    /// Functions found in the binaries with another structural hash. Their coverage is ignored
+    public var functionsMismatched: UInt64 = 0
+    public var filesEmitted: UInt64 = 0
+    public var segmentsEmitted: UInt64 = 0
+    /// Profile counters, evaluated regions and the result memory
+    public var bytesAllocated: UInt64 = 0
+    
+    public init() {}
+}
+
+extension ParsingStats {
+    internal init(cValue: CCoverageStats) {
+        self.loadTime = cValue.load_ns
+        self.decodeTime = cValue.decode_ns
+        self.readProfileTime = cValue.read_profile_ns
+        self.mappingTime = cValue.mapping_ns
+        self.segmentsTime = cValue.segments_ns
+        self.conversionTime = cValue.convert_ns
+        self.recordsRead = cValue.records_read
+        self.functionsMatched = cValue.functions_matched
+        self.functionsMismatched = cValue.functions_mismatched
+        self.filesEmitted = cValue.files_emitted
+        self.segmentsEmitted = cValue.segments_emitted
+        self.bytesAllocated = cValue.bytes_allocated
+    }
+    
+    internal var cValue: CCoverageStats {
+        CCoverageStats(load_ns: loadTime, decode_ns: decodeTime, read_profile_ns: readProfileTime,
+                       mapping_ns: mappingTime, segments_ns: segmentsTime, convert_ns: conversionTime,
+                       records_read: recordsRead, functions_matched: functionsMatched,
+                       functions_mismatched: functionsMismatched, files_emitted: filesEmitted,
+                       segments_emitted: segmentsEmitted, bytes_allocated: bytesAllocated)
+    }
+}
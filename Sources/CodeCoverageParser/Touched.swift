@@ -0,0 +1,38 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+import Foundation
+internal import CCodeCoverageParser
+
+/// Files and functions with executed code, for test impact analysis.
+/// Read from the profile counters and file lists of the functions without building regions,
+/// so it's much cheaper than CoverageInfo. Functions with any executed counter are included.
+public struct TouchedCode: Hashable, Equatable, Codable {
+    /// Touched files sorted by name
+    public let files: [String]
+    public let functions: [Function]
+    
+    public struct Function: Hashable, Equatable, Codable {
+        public let name: String
+        /// Structural hash of the function
+        public let hash: UInt64
+        /// Indexes of the function files in TouchedCode.files
+        public let files: [Int]
+    }
+}
+
+extension TouchedCode {
+    /// Copies files and functions from C structures. Memory is owned and freed by the parser
+    internal init(cValue: CCoverageTouched) {
+        self.files = UnsafeBufferPointer(start: cValue.files, count: cValue.files_count).map {
+            String(cString: $0)
+        }
+        self.functions = UnsafeBufferPointer(start: cValue.functions, count: cValue.functions_count).map {
+            Function(name: String(cString: $0.name), hash: $0.hash,
+                     files: UnsafeBufferPointer(start: $0.files, count: $0.files_count).map { Int($0) })
+        }
+    }
+}
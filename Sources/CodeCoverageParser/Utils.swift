@@ -75,3 +75,37 @@ extension Array where Element: StringProtocol {
         return try body(ptrs)
     }
 }
+
+extension Optional where Wrapped: StringProtocol {
+    func withOptionalCString<R>(_ body: (UnsafePointer<CChar>?) throws -> R) rethrows -> R {
+        guard let self else { return try body(nil) }
+        return try self.withCString(body)
+    }
+}
+
+extension UInt64 {
+    // Sum clamped to the max value, like SaturatingAdd in the plugin. Merged counts never trap or wrap
+    static func saturatingSum(_ lhs: UInt64, _ rhs: UInt64) -> UInt64 {
+        let (sum, overflow) = lhs.addingReportingOverflow(rhs)
+        return overflow ? .max : sum
+    }
+}
+
+extension Collection {
+    // Index of the first element matching the predicate. Collection should be partitioned by it
+    func partitioningIndex(where predicate: (Element) throws -> Bool) rethrows -> Index {
+        var low = startIndex
+        var count = self.count
+        while count > 0 {
+            let half = count / 2
+            let middle = index(low, offsetBy: half)
+            if try predicate(self[middle]) {
+                count = half
+            } else {
+                low = index(after: middle)
+                count -= half + 1
+            }
+        }
+        return low
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ * Unless explicitly stated otherwise all files in this repository are licensed under the Apache License Version 2.0.
+ * This product includes software developed at Datadog (https://www.datadoghq.com/).
+ * Copyright 2024-Present Datadog, Inc.
+ */
+
+import Foundation
+
+/// Streaming consumer of the coverage.
+/// Files are visited one by one, so the whole coverage is never materialized as CoverageInfo.
+public protocol CoverageVisitor {
+    /// Called before the segments of the file
+    mutating func beginFile(name: String)
+    /// Covered segment of the current file. Segments are visited in the source order
+    mutating func visit(segment: CoverageInfo.Segment)
+    /// Called after the last segment of the file
+    mutating func endFile()
+}
+
+/// Type erased visitor for the plugin callbacks. Plugin segments are converted to the covered regions
+internal struct VisitorContext {
+    var regions = CoverageRegionBuilder()
+    let beginFile: (String) -> Void
+    let visitSegment: (CoverageInfo.Segment) -> Void
+    let endFile: () -> Void
+    
+    static func with<V: CoverageVisitor, R>(_ visitor: inout V, _ body: (inout VisitorContext) -> R) -> R {
+        withUnsafeMutablePointer(to: &visitor) { visitor in
+            var context = VisitorContext(beginFile: { visitor.pointee.beginFile(name: $0) },
+                                         visitSegment: { visitor.pointee.visit(segment: $0) },
+                                         endFile: { visitor.pointee.endFile() })
+            return body(&context)
+        }
+    }
+}
@@ -6,6 +6,7 @@
 
 import XCTest
 @testable import CodeCoverage
+@testable import CodeCoverageCollector
 
 func test234() {}
 
@@ -17,6 +18,13 @@ func test456() {
     test123()
 }
 
+func testBranch(_ flag: Bool) -> Int {
+    if flag {
+        return 1
+    }
+    return 0
+}
+
 final class CodeCoverageTests: XCTestCase {
     nonisolated(unsafe) static var coverage: CoverageProcessor! = nil
     
@@ -59,6 +67,332 @@ final class CodeCoverageTests: XCTestCase {
         
         let covered = try coverage.filesCovered(in: file)
         print(covered)
+        for file in covered.files.values {
+            XCTAssert(file.regions.allSatisfy { $0.count > 0 })
+            XCTAssertEqual(file.regions, file.regions.sorted { $0.location < $1.location })
+            XCTAssertEqual(CoverageInfo.File(name: file.name, segments: file.segments), file)
+            XCTAssert(file.regions.allSatisfy { file.segment(at: $0.location) == $0 })
+            // unsorted input is sorted, the last region of the same location is kept
+            XCTAssertEqual(CoverageInfo.File(name: file.name, regions: file.regions.reversed() + file.regions), file)
+        }
+        let doubled = covered.merged(with: covered)
+        for (name, file) in covered.files {
+            XCTAssertEqual(doubled.files[name]?.regions.map(\.location), file.regions.map(\.location))
+            XCTAssertEqual(doubled.files[name]?.regions.map(\.count), file.regions.map { $0.count * 2 })
+        }
+        let encoded = try JSONEncoder().encode(covered)
+        XCTAssertEqual(try JSONDecoder().decode(CoverageInfo.self, from: encoded), covered)
+    }
+
+    func testSnapshot() throws {
+        let coverage = Self.coverage!
+        
+        let file = try gathered(test456, stop: coverage.stopCoverageGathering)
+        defer { try? FileManager.default.removeItem(at: file) }
+        let snapshot = try gathered(test456, stop: coverage.stopCoverageGatheringInMemory)
+        
+        // Same code is executed after the reset, so counts match too
+        let fromFile = try coverage.filesCovered(in: file)
+        let fromSnapshot = try coverage.filesCovered(in: snapshot)
+        XCTAssertFalse(fromFile.files.isEmpty)
+        XCTAssertEqual(fromSnapshot, fromFile)
+    }
+    
+    // Executes the code between the start and the stop. Same instrumented code runs in every call,
+    // stop methods are passed without closures, so they don't add counters
+    private func gathered<T>(_ body: () -> Void, stop: () throws -> T) throws -> T {
+        try Self.coverage.startCoverageGathering()
+        body()
+        return try stop()
+    }
+    
+    func testProfiledBinaries() throws {
+        let coverage = Self.coverage!
+
+        try coverage.startCoverageGathering()
+        test123()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+
+        let profiled = coverage.profiledBinaries
+        XCTAssertFalse(profiled.isEmpty)
+        XCTAssertLessThanOrEqual(profiled.count, coverage.binaries.count)
+        XCTAssert(profiled.allSatisfy { binary in coverage.binaries.contains { $0.url == binary.url } })
+        XCTAssertFalse(try coverage.filesCovered(in: file).files.isEmpty)
+    }
+
+    func testCoverageWindows() throws {
+        let coverage = Self.coverage!
+
+        let outer = coverage.startCoverageWindow()
+        test123()
+        let inner = coverage.startCoverageWindow()
+        test456()
+        let innerCoverage = try coverage.parser.filesCovered(in: inner.end())
+        let outerCoverage = try coverage.filesCovered(in: outer)
+
+        XCTAssertFalse(innerCoverage.files.isEmpty)
+        XCTAssert(Set(innerCoverage.files.keys).isSubset(of: Set(outerCoverage.files.keys)))
+        XCTAssertThrowsError(try inner.delta())
+    }
+
+    func testCoverageWindowCounts() throws {
+        let coverage = Self.coverage!
+
+        let window = coverage.startCoverageWindow()
+        for _ in 0..<3 {
+            _ = testBranch(false)
+        }
+        let counted = try coverage.filesCovered(in: window)
+        XCTAssert(counted.files.values.contains { $0.regions.contains { $0.count == 3 } })
+
+        // Counters reset by the gathering are below the window snapshot, they don't wrap around
+        try coverage.startCoverageGathering()
+        _ = testBranch(true)
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+        let afterReset = try coverage.parser.filesCovered(in: window.end())
+        let gathered = try coverage.filesCovered(in: file)
+        for (name, file) in afterReset.files {
+            for region in file.regions {
+                XCTAssertLessThanOrEqual(region.count, gathered.files[name]?.segment(at: region.location)?.count ?? 1)
+            }
+        }
+    }
+
+    func testMappingCache() throws {
+        let coverage = Self.coverage!
+        let cache = coverage.tempDir.appendingPathComponent("mappings-\(UUID().uuidString)", isDirectory: true)
+        defer { try? FileManager.default.removeItem(at: cache) }
+
+        try coverage.startCoverageGathering()
+        test456()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+
+        // First parser decodes the binaries and fills the cache, second one maps it
+        let cold = try CoverageParser(for: coverage.collector, loadInitialCoverage: false, mappingCache: cache)
+        XCTAssertFalse(try FileManager.default.contentsOfDirectory(atPath: cache.path).isEmpty)
+        let warm = try CoverageParser(for: coverage.collector, loadInitialCoverage: false, mappingCache: cache)
+        XCTAssertEqual(try warm.filesCovered(in: file), try cold.filesCovered(in: file))
+        XCTAssertEqual(try warm.filesCovered(in: file), try coverage.filesCovered(in: file))
+    }
+
+    func testFileFilter() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test456()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+
+        let all = try coverage.filesCovered(in: file)
+        let tests = try XCTUnwrap(all.files.keys.first { $0.hasSuffix("CodeCoverageTests.swift") })
+        let excluding = try CoverageParser(for: coverage.collector, loadInitialCoverage: false,
+                                           fileFilter: .init(exclude: ["*/CodeCoverageTests.swift"]))
+        XCTAssertEqual(Set(try excluding.filesCovered(in: file).files.keys), Set(all.files.keys).subtracting([tests]))
+        // path without glob characters is a prefix
+        let including = try CoverageParser(for: coverage.collector, loadInitialCoverage: false,
+                                           fileFilter: .init(include: [tests]))
+        XCTAssertEqual(try including.filesCovered(in: file).files, [tests: all.files[tests]!])
+        // prefix matches whole path components only
+        let directory = URL(fileURLWithPath: tests).deletingLastPathComponent().path
+        let inDirectory = try CoverageParser(for: coverage.collector, loadInitialCoverage: false,
+                                             fileFilter: .init(include: [directory]))
+        XCTAssertEqual(try inDirectory.filesCovered(in: file).files[tests], all.files[tests])
+        let partial = try CoverageParser(for: coverage.collector, loadInitialCoverage: false,
+                                         fileFilter: .init(include: [String(tests.dropLast(".swift".count))]))
+        XCTAssertTrue(try partial.filesCovered(in: file).files.isEmpty)
+        XCTAssertThrowsError(try CoverageParser(for: coverage.collector, loadInitialCoverage: false,
+                                                fileFilter: .init(include: ["[a"])))
+    }
+
+    func testTouchedCode() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test456()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+
+        let touched = try coverage.touchedCode(in: file)
+        XCTAssertEqual(touched.files, touched.files.sorted())
+        XCTAssert(Set(try coverage.filesCovered(in: file).files.keys).isSubset(of: Set(touched.files)))
+        XCTAssert(touched.functions.allSatisfy { !$0.files.isEmpty && $0.files.allSatisfy(touched.files.indices.contains) })
+        XCTAssert(touched.functions.contains { $0.name.contains("test456") })
+        // records of one function from many binaries or translation units are merged
+        XCTAssertEqual(Set(touched.functions.map { "\($0.name)#\($0.hash)" }).count, touched.functions.count)
+        XCTAssert(touched.functions.allSatisfy { $0.files == Array(Set($0.files)).sorted() })
+        XCTAssertEqual(try coverage.touchedCode(in: Data(contentsOf: file)), touched)
+    }
+
+    struct CollectingVisitor: CoverageVisitor {
+        var files: [String: [CoverageInfo.Location: CoverageInfo.Segment]] = [:]
+        var current: (name: String, segments: [CoverageInfo.Location: CoverageInfo.Segment])? = nil
+
+        mutating func beginFile(name: String) {
+            current = (name, [:])
+        }
+
+        mutating func visit(segment: CoverageInfo.Segment) {
+            current!.segments[segment.location] = segment
+        }
+
+        mutating func endFile() {
+            files[current!.name] = current!.segments
+            current = nil
+        }
+    }
+
+    func testVisitor() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test456()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+
+        var visitor = CollectingVisitor()
+        try coverage.parser.visitFilesCovered(in: file, visitor: &visitor)
+        XCTAssertNil(visitor.current)
+        XCTAssertEqual(visitor.files, try coverage.filesCovered(in: file).files.mapValues(\.segments))
+    }
+
+    func testLineCoverage() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test456()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+
+        let lines = try coverage.linesCovered(in: file, withCounts: true)
+        XCTAssertEqual(Set(lines.files.keys), Set(try coverage.filesCovered(in: file).files.keys))
+        let tests = try XCTUnwrap(lines.files.values.first { $0.name.hasSuffix("CodeCoverageTests.swift") })
+        // test234 is executed, empty line between the functions has no code
+        XCTAssert(tests.isCovered(line: 11))
+        XCTAssertFalse(tests.isCoverable(line: 12))
+        for file in lines.files.values {
+            XCTAssertEqual(file.counts.count, file.linesCount)
+            for line in 1...max(file.linesCount, 1) {
+                XCTAssert(!file.isCovered(line: line) || file.isCoverable(line: line))
+                XCTAssertEqual(file.isCovered(line: line), file.counts.indices.contains(line - 1) && file.counts[line - 1] > 0)
+            }
+        }
+
+        let merged = tests.merged(with: tests)
+        XCTAssertEqual(merged.covered, tests.covered)
+        XCTAssertEqual(merged.counts, tests.counts.map { $0 * 2 })
+        XCTAssert(try coverage.linesCovered(in: file).files.values.allSatisfy { $0.counts.isEmpty })
+    }
+
+    func testCompactCoverage() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test123()
+        let first = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: first) }
+        try coverage.startCoverageGathering()
+        test456()
+        let second = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: second) }
+
+        let compact = try coverage.parser.compactFilesCovered(in: first)
+        let info = try coverage.filesCovered(in: first)
+        XCTAssertEqual(compact.info, info)
+        XCTAssertEqual(CompactCoverageInfo(info), compact)
+        XCTAssertEqual(compact.names, compact.names.sorted())
+        XCTAssertEqual(compact.fileID(for: compact.names.last!), compact.filesCount - 1)
+        XCTAssertNil(compact.fileID(for: ""))
+
+        // in place add and linear merge give the same result as the dictionary merge
+        XCTAssertEqual(compact.merged(with: compact).info, info.merged(with: info))
+        let other = try coverage.parser.compactFilesCovered(in: second)
+        let otherInfo = try coverage.filesCovered(in: second)
+        XCTAssertEqual(compact.merged(with: other).info, info.merged(with: otherInfo))
+        XCTAssertEqual(CompactCoverageInfo().merged(with: other), other)
+    }
+
+    func testBaselineCoverage() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test123()
+        let first = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: first) }
+        try coverage.startCoverageGathering()
+        test123()
+        test456()
+        let second = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: second) }
+
+        // own parser, so the baseline of the shared one isn't changed
+        let parser = try CoverageParser(for: coverage.collector, loadInitialCoverage: false)
+        XCTAssertEqual(try parser.filesCovered(in: first, relativeToBaseline: .newRegions),
+                       try parser.filesCovered(in: first))
+        try parser.setBaseline(profile: first)
+        for mode in [CoverageParser.BaselineMode.newRegions, .subtractCounts] {
+            let same = try parser.filesCovered(in: first, relativeToBaseline: mode)
+            XCTAssert(same.files.values.allSatisfy { $0.regions.isEmpty })
+        }
+
+        let full = try parser.filesCovered(in: second)
+        let new = try parser.filesCovered(in: second, relativeToBaseline: .newRegions)
+        XCTAssertFalse(new.files.values.allSatisfy { $0.regions.isEmpty })
+        XCTAssert(Set(new.files.keys).isSubset(of: full.files.keys))
+
+        try parser.setBaseline(profile: Data())
+        XCTAssertEqual(try parser.filesCovered(in: second, relativeToBaseline: .subtractCounts), full)
+    }
+
+    func testBaselineAboveProfile() throws {
+        let coverage = Self.coverage!
+        // Counters are reset on start, so the baseline has more executions of the function than the profile
+        try coverage.startCoverageGathering()
+        for _ in 0..<3 {
+            _ = testBranch(false)
+        }
+        let baseline = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: baseline) }
+        try coverage.startCoverageGathering()
+        _ = testBranch(true)
+        let profile = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: profile) }
+
+        let parser = try CoverageParser(for: coverage.collector, loadInitialCoverage: false)
+        try parser.setBaseline(profile: baseline)
+        let full = try parser.filesCovered(in: profile)
+        let relative = try parser.filesCovered(in: profile, relativeToBaseline: .subtractCounts)
+        // Region after the branch is an expression of the counters. It's below the baseline, not negative
+        XCTAssertFalse(relative.files.isEmpty)
+        for (name, file) in relative.files {
+            for region in file.regions {
+                XCTAssertLessThanOrEqual(region.count, full.files[name]?.segment(at: region.location)?.count ?? 0)
+            }
+        }
+    }
+
+    func testParsingStats() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test456()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+
+        XCTAssertGreaterThan(coverage.loadStats.loadTime, 0)
+        var stats = ParsingStats()
+        let covered = try coverage.filesCovered(in: file, stats: &stats)
+        XCTAssertEqual(covered, try coverage.filesCovered(in: file))
+        XCTAssertEqual(stats.loadTime, 0)
+        XCTAssertGreaterThan(stats.mappingTime, 0)
+        XCTAssertGreaterThanOrEqual(stats.mappingTime, stats.decodeTime)
+        XCTAssertGreaterThan(stats.recordsRead, 0)
+        XCTAssertGreaterThan(stats.functionsMatched, 0)
+        XCTAssertLessThanOrEqual(stats.functionsMatched + stats.functionsMismatched, stats.recordsRead)
+        XCTAssertEqual(stats.filesEmitted, UInt64(covered.files.count))
+        XCTAssertGreaterThan(stats.segmentsEmitted, 0)
+        XCTAssertGreaterThan(stats.bytesAllocated, 0)
+
+        // counters are added to the passed stats
+        let first = stats
+        _ = try coverage.filesCovered(in: Data(contentsOf: file), stats: &stats)
+        XCTAssertEqual(stats.recordsRead, first.recordsRead * 2)
+        XCTAssertEqual(stats.filesEmitted, first.filesEmitted * 2)
     }
 
     func testPerformanceExample() {
@@ -72,6 +406,39 @@ final class CodeCoverageTests: XCTestCase {
         }
     }
     
+    func testResetKernelPerformance() {
+        // Counters of the big app. Most of them are already reset between tests
+        let counters = UnsafeMutableRawBufferPointer.allocate(byteCount: 64 << 20, alignment: 64)
+        defer { counters.deallocate() }
+        counters.initializeMemory(as: UInt8.self, repeating: 0)
+        self.measure {
+            counters[counters.count / 2] = 1
+            counters.resetCoverageCounters(to: 0)
+        }
+        XCTAssert(counters.allSatisfy { $0 == 0 })
+    }
+    
+    func testResetMemsetPerformance() {
+        let counters = UnsafeMutableRawBufferPointer.allocate(byteCount: 64 << 20, alignment: 64)
+        defer { counters.deallocate() }
+        counters.initializeMemory(as: UInt8.self, repeating: 0)
+        self.measure {
+            counters[counters.count / 2] = 1
+            memset(counters.baseAddress!, 0, counters.count)
+        }
+    }
+    
+    func testParsingPerformance() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test456()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+        self.measure {
+            let _ = try! coverage.filesCovered(in: file)
+        }
+    }
+
     func testMultithreadedParsing() throws {
         let iterations = 100
         let files = try (0..<iterations).map { index in
@@ -89,4 +456,63 @@ final class CodeCoverageTests: XCTestCase {
             let _ = try! Self.coverage.filesCovered(in: file)
         }
     }
+    
+    func testAccumulator() throws {
+        let coverage = Self.coverage!
+        try coverage.startCoverageGathering()
+        test456()
+        let file = try coverage.stopCoverageGathering()
+        defer { try? FileManager.default.removeItem(at: file) }
+        
+        let single = try coverage.filesCovered(in: file)
+        let accumulator = coverage.parser.makeAccumulator()
+        try accumulator.add(profile: file)
+        XCTAssertEqual(try accumulator.finalize(), single)
+        
+        try accumulator.add(profile: Data(contentsOf: file))
+        let double = try accumulator.finalize()
+        XCTAssertEqual(Set(double.files.keys), Set(single.files.keys))
+        for (name, file) in single.files {
+            for segment in file.regions {
+                XCTAssertEqual(double.files[name]?.segment(at: segment.location)?.count, segment.count * 2)
+            }
+        }
+    }
+    
+    func testBatchParsing() throws {
+        let iterations = 100
+        let files = try (0..<iterations).map { index in
+            try Self.coverage.startCoverageGathering()
+            if index % 2 == 0 {
+                test123()
+            } else {
+                test456()
+            }
+            return try Self.coverage.stopCoverageGathering()
+        }
+        defer { files.forEach { try? FileManager.default.removeItem(at: $0) } }
+        let results = Self.coverage.filesCovered(in: files)
+        XCTAssertEqual(results.count, files.count)
+        for (file, result) in zip(files, results) {
+            XCTAssertEqual(try result.get(), try Self.coverage.filesCovered(in: file))
+        }
+    }
+
+    func testMergedParsing() throws {
+        let iterations = 20
+        let files = try (0..<iterations).map { index in
+            try Self.coverage.startCoverageGathering()
+            if index % 2 == 0 {
+                test123()
+            } else {
+                test456()
+            }
+            return try Self.coverage.stopCoverageGathering()
+        }
+        defer { files.forEach { try? FileManager.default.removeItem(at: $0) } }
+        let results = try files.map { try Self.coverage.filesCovered(in: $0) }
+        let folded = results.dropFirst().reduce(results[0]) { $0.merged(with: $1) }
+        XCTAssertEqual(try Self.coverage.parser.mergedFilesCovered(in: files), folded)
+        XCTAssert(try Self.coverage.parser.mergedFilesCovered(in: []).files.isEmpty)
+    }
 }